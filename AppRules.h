@@ -0,0 +1,222 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// ===== App Rules (ルールファイルの解析と照合) =====
+// Windows に依存しない部分。読み込み・適用は main.cpp 側で行う。
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cwctype>
+#include <cwchar>
+
+inline std::wstring AppRuleToLower(const std::wstring& s) {
+    std::wstring t = s;
+    for (size_t i = 0; i < t.size(); ++i) t[i] = (wchar_t)towlower(t[i]);
+    return t;
+}
+
+// ルールファイル（exe名 / 表示名のパターン → 動作）。1行1ルール、上の行ほど優先。
+//   exe:teams.exe            A
+//   name:"*通知*"            ignore
+//   exe:chrome*              B gain=0.8
+// パターンは大文字小文字を区別しない。'*' は先頭・末尾のみ（完全/前方/後方/部分一致）。
+#define RULE_SIDE_NONE 0
+#define RULE_SIDE_A    1
+#define RULE_SIDE_B    2
+
+#define RULE_ANCHOR_BEGIN L'\x02'  // 前方一致用の番兵
+#define RULE_ANCHOR_END   L'\x03'  // 後方一致用の番兵
+
+struct AppRule {
+    int   side;    // RULE_SIDE_*
+    bool  ignore;  // コンボに出さない
+    float gain;    // 初期音量 0.0-1.0（負なら指定なし）
+};
+
+// パターン集合を読み込み時に Aho-Corasick オートマトンへ変換する。
+// 各状態に「そこで一致が確定する最優先ルール」を前計算しておくので、
+// 照合は文字列長に比例するだけでルール数に依存しない。
+struct RuleMatcher {
+    struct Node {
+        std::map<wchar_t, int> next;
+        int fail;
+        int best;  // この状態（fail連鎖込み）で一致する最小ルール番号。なしは -1
+    };
+    std::vector<Node> nodes;
+
+    RuleMatcher() { Clear(); }
+
+    void Clear() {
+        nodes.assign(1, Node{ {}, 0, -1 });
+    }
+
+    void Add(const std::wstring& key, int ruleIndex) {
+        int cur = 0;
+        for (size_t i = 0; i < key.size(); ++i) {
+            std::map<wchar_t, int>::iterator it = nodes[cur].next.find(key[i]);
+            if (it == nodes[cur].next.end()) {
+                int n = (int)nodes.size();
+                nodes[cur].next[key[i]] = n;
+                nodes.push_back(Node{ {}, 0, -1 });
+                cur = n;
+            }
+            else {
+                cur = it->second;
+            }
+        }
+        if (nodes[cur].best < 0 || ruleIndex < nodes[cur].best) nodes[cur].best = ruleIndex;
+    }
+
+    // fail リンクを張り、best を fail 先から伝播（BFS順なので fail 先は確定済み）
+    void Build() {
+        std::vector<int> queue;
+        for (std::map<wchar_t, int>::iterator it = nodes[0].next.begin(); it != nodes[0].next.end(); ++it) {
+            nodes[it->second].fail = 0;
+            queue.push_back(it->second);
+        }
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int u = queue[head];
+            int fb = nodes[nodes[u].fail].best;
+            if (fb >= 0 && (nodes[u].best < 0 || fb < nodes[u].best)) nodes[u].best = fb;
+
+            for (std::map<wchar_t, int>::iterator it = nodes[u].next.begin(); it != nodes[u].next.end(); ++it) {
+                int f = nodes[u].fail;
+                while (f != 0 && nodes[f].next.find(it->first) == nodes[f].next.end()) f = nodes[f].fail;
+                std::map<wchar_t, int>::iterator ft = nodes[f].next.find(it->first);
+                nodes[it->second].fail = (ft != nodes[f].next.end() && ft->second != it->second) ? ft->second : 0;
+                queue.push_back(it->second);
+            }
+        }
+    }
+
+    // text は小文字化済み。番兵で挟んだ文字列として走査する
+    int Match(const std::wstring& text) const {
+        int result = nodes[0].best;
+        int cur = 0;
+        for (size_t i = 0; i < text.size() + 2; ++i) {
+            wchar_t c = (i == 0) ? RULE_ANCHOR_BEGIN : (i == text.size() + 1) ? RULE_ANCHOR_END : text[i - 1];
+            std::map<wchar_t, int>::const_iterator it;
+            while ((it = nodes[cur].next.find(c)) == nodes[cur].next.end() && cur != 0) cur = nodes[cur].fail;
+            if (it != nodes[cur].next.end()) cur = it->second;
+            int b = nodes[cur].best;
+            if (b >= 0 && (result < 0 || b < result)) result = b;
+        }
+        return result;
+    }
+};
+
+struct AppRuleSet {
+    std::vector<AppRule> rules;
+    RuleMatcher exeMatcher;
+    RuleMatcher nameMatcher;
+};
+
+// "*foo" / "foo*" / "*foo*" / "foo" → 番兵付きのキーへ。中間の '*' は不可
+inline bool CompileRulePattern(const std::wstring& pattern, std::wstring& key) {
+    std::wstring p = AppRuleToLower(pattern);
+    bool openBegin = !p.empty() && p[0] == L'*';
+    if (openBegin) p.erase(0, 1);
+    bool openEnd = !p.empty() && p[p.size() - 1] == L'*';
+    if (openEnd) p.erase(p.size() - 1);
+    if (p.find(L'*') != std::wstring::npos) return false;
+    if (p.empty() && !(openBegin || openEnd)) return false;
+
+    key.clear();
+    if (!openBegin) key += RULE_ANCHOR_BEGIN;
+    key += p;
+    if (!openEnd) key += RULE_ANCHOR_END;
+    return true;
+}
+
+// 1行をルールへ。成功したら field に L"exe" / L"name"、key に照合キーを返す
+inline bool ParseRuleLine(const std::wstring& line, AppRule& rule, std::wstring& field, std::wstring& key) {
+    size_t pos = 0;
+    while (pos < line.size() && iswspace(line[pos])) ++pos;
+    if (pos >= line.size() || line[pos] == L'#') return false;
+
+    size_t colon = line.find(L':', pos);
+    if (colon == std::wstring::npos) return false;
+    field = AppRuleToLower(line.substr(pos, colon - pos));
+    if (field != L"exe" && field != L"name") return false;
+
+    // パターン（空白を含む場合は "..." で囲む）
+    std::wstring pattern;
+    pos = colon + 1;
+    if (pos < line.size() && line[pos] == L'"') {
+        size_t close = line.find(L'"', pos + 1);
+        if (close == std::wstring::npos) return false;
+        pattern = line.substr(pos + 1, close - pos - 1);
+        pos = close + 1;
+    }
+    else {
+        size_t end = pos;
+        while (end < line.size() && !iswspace(line[end])) ++end;
+        pattern = line.substr(pos, end - pos);
+        pos = end;
+    }
+    if (!CompileRulePattern(pattern, key)) return false;
+
+    // 動作: A / B / ignore / gain=0.0-1.0（複数可）
+    rule = AppRule{ RULE_SIDE_NONE, false, -1.0f };
+    bool any = false;
+    while (pos < line.size()) {
+        while (pos < line.size() && iswspace(line[pos])) ++pos;
+        if (pos >= line.size() || line[pos] == L'#') break;
+        size_t end = pos;
+        while (end < line.size() && !iswspace(line[end])) ++end;
+        std::wstring tok = AppRuleToLower(line.substr(pos, end - pos));
+        pos = end;
+
+        if (tok == L"a") rule.side = RULE_SIDE_A;
+        else if (tok == L"b") rule.side = RULE_SIDE_B;
+        else if (tok == L"ignore") rule.ignore = true;
+        else if (tok.compare(0, 5, L"gain=") == 0) {
+            wchar_t* stop = nullptr;
+            double g = wcstod(tok.c_str() + 5, &stop);
+            if (!stop || *stop != L'\0' || stop == tok.c_str() + 5) return false;
+            if (g < 0.0) g = 0.0; else if (g > 1.0) g = 1.0;
+            rule.gain = (float)g;
+        }
+        else return false;
+        any = true;
+    }
+    return any;
+}
+
+// ファイル全体を解析してオートマトンを構築。不正な行は読み飛ばす
+inline void CompileAppRules(const std::wstring& text, AppRuleSet& set) {
+    set.rules.clear();
+    set.exeMatcher.Clear();
+    set.nameMatcher.Clear();
+
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find_first_of(L"\r\n", begin);
+        if (end == std::wstring::npos) end = text.size();
+        std::wstring line = text.substr(begin, end - begin);
+        begin = end + 1;
+
+        AppRule rule;
+        std::wstring field, key;
+        if (!ParseRuleLine(line, rule, field, key)) continue;
+
+        int index = (int)set.rules.size();
+        set.rules.push_back(rule);
+        if (field == L"exe") set.exeMatcher.Add(key, index);
+        else                 set.nameMatcher.Add(key, index);
+    }
+
+    set.exeMatcher.Build();
+    set.nameMatcher.Build();
+}
+
+// exe名・表示名のどちらかに一致した最優先ルール番号（なしは -1）
+inline int MatchAppRule(const AppRuleSet& set, const std::wstring& exe, const std::wstring& name) {
+    if (set.rules.empty()) return -1;
+    int e = set.exeMatcher.Match(AppRuleToLower(exe));
+    int n = set.nameMatcher.Match(AppRuleToLower(name));
+    if (e < 0) return n;
+    if (n < 0) return e;
+    return (e < n) ? e : n;
+}
@@ -0,0 +1,62 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// ===== Peak Meter =====
+// Windows に依存しない部分。ピーク値の取得と描画は main.cpp 側で行う。
+#pragma once
+
+#include <cmath>
+
+// 1フレーム1回のピーク値から表示レベルを作る（瞬時に上昇、ゆっくり下降＋ピークホールド）。
+// 描画幅のピクセルへ量子化し、見た目が変わるときだけ再描画させる。
+#define METER_FPS             30
+#define METER_RANGE_DB        60.0f  // 表示範囲 -60dB..0dB
+#define METER_DECAY_PER_FRAME 0.04f  // 下降速度（フルスケール比/フレーム）
+#define METER_HOLD_FRAMES     20     // ピークホールド保持フレーム数
+
+struct PeakMeter {
+    float level;     // 表示レベル 0..1
+    float hold;      // ピークホールド 0..1
+    int   holdLeft;  // ホールド残りフレーム
+    int   barPx;     // 最後に描画を要求したバー幅
+    int   holdPx;    // 最後に描画を要求したホールド位置
+};
+
+inline void PeakMeterReset(PeakMeter& m) {
+    m = PeakMeter{ 0.0f, 0.0f, 0, 0, 0 };
+}
+
+// 振幅ピーク（0..1）→ dB 目盛りの 0..1
+inline float PeakToMeterScale(float peak) {
+    if (peak <= 0.0f) return 0.0f;
+    float v = (20.0f * log10f(peak) + METER_RANGE_DB) / METER_RANGE_DB;
+    if (v < 0.0f) v = 0.0f; else if (v > 1.0f) v = 1.0f;
+    return v;
+}
+
+inline void PeakMeterUpdate(PeakMeter& m, float value) {
+    if (value < 0.0f) value = 0.0f; else if (value > 1.0f) value = 1.0f;
+
+    if (value >= m.level) m.level = value;
+    else {
+        m.level -= METER_DECAY_PER_FRAME;
+        if (m.level < value) m.level = value;
+    }
+
+    if (value >= m.hold) { m.hold = value; m.holdLeft = METER_HOLD_FRAMES; }
+    else if (m.holdLeft > 0) m.holdLeft--;
+    else {
+        m.hold -= METER_DECAY_PER_FRAME;
+        if (m.hold < m.level) m.hold = m.level;
+    }
+}
+
+// widthPx へ量子化して前回と変わっていれば true（barPx/holdPx を更新）
+inline bool PeakMeterNeedsRepaint(PeakMeter& m, int widthPx) {
+    if (widthPx < 0) widthPx = 0;
+    int bar = (int)(m.level * widthPx + 0.5f);
+    int hold = (int)(m.hold * widthPx + 0.5f);
+    if (bar == m.barPx && hold == m.holdPx) return false;
+    m.barPx = bar;
+    m.holdPx = hold;
+    return true;
+}
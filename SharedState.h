@@ -0,0 +1,94 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// ===== Shared State (外部ツール向け公開ブロック) =====
+// バランサーの現在状態（選択中のペア・トラックバー位置・カーブ・各セッションの音量）を
+// 名前付き共有メモリへ seqlock で公開する。書き込みは UI スレッドの1か所だけ、
+// 読み手はいくつでもよく、ロックなしで一貫したスナップショットを取れる。
+//
+// このヘッダーは Windows に依存しない。共有メモリの確保は各自で行う：
+//   Windows: OpenFileMappingW(FILE_MAP_READ, FALSE, SHARED_STATE_NAME) + MapViewOfFile
+//   POSIX:   shm_open + mmap（tests/test_shared_state.cpp 参照）
+// 書き手が終了すると flags から HAS_A / HAS_B / APPLIED が落ちる。
+// 読み手は SharedStateRead() にマップした先頭アドレスを渡す。
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#define SHARED_STATE_NAME       L"Local\\TwoAppVolumeBalancer.State"
+#define SHARED_STATE_MAGIC      0x53425654u  // 'TVBS'
+#define SHARED_STATE_VERSION    1u           // 互換のないレイアウト変更で上げる
+#define SHARED_STATE_NAME_CHARS 128
+
+#define SHARED_STATE_HAS_A      0x1u  // A が選択されている
+#define SHARED_STATE_HAS_B      0x2u  // B が選択されている
+#define SHARED_STATE_APPLIED    0x4u  // gain が実際に適用中（復元後は落ちる）
+
+struct SharedSessionState {
+    uint32_t pid;
+    float    gain;                           // 適用中の音量 0.0-1.0
+    uint16_t name[SHARED_STATE_NAME_CHARS];  // 表示名（UTF-16、NUL終端）
+};
+
+struct SharedStatePayload {
+    uint32_t           flags;     // SHARED_STATE_*
+    uint32_t           mode;      // カーブ（1=中央 100-100, 2=中央 50-50）
+    int32_t            position;  // トラックバー位置 0..100
+    uint32_t           reserved;
+    SharedSessionState a;
+    SharedSessionState b;
+};
+
+struct SharedStateHeader {
+    uint32_t              magic;
+    uint32_t              version;
+    uint32_t              size;  // ブロック全体のバイト数。同じ版数で末尾に項目を足す場合の判定用
+    std::atomic<uint32_t> seq;   // 奇数 = 書き込み中
+};
+
+struct SharedStateBlock {
+    SharedStateHeader  header;
+    SharedStatePayload payload;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+    "seq must be lock-free to live in shared memory");
+
+// 書き手：ヘッダーを設定（新規ブロックはゼロ初期化済みであること）。
+// 読み手が開いたままの既存ブロックを引き継ぐ場合は seq を巻き戻さないので、
+// 読み手が前の書き手の値と取り違えることはない
+inline void SharedStateInit(SharedStateBlock* blk) {
+    bool reuse = (blk->header.magic == SHARED_STATE_MAGIC);
+    blk->header.magic = SHARED_STATE_MAGIC;
+    blk->header.version = SHARED_STATE_VERSION;
+    blk->header.size = (uint32_t)sizeof(SharedStateBlock);
+    if (!reuse) blk->header.seq.store(0, std::memory_order_release);
+}
+
+// 書き手：seq を奇数にしてから本体を書き、偶数に戻す（書き手は1つだけ）。
+// 前の書き手が書き込み途中で落ちて奇数のままなら、そのまま続きとして書く
+inline void SharedStateWrite(SharedStateBlock* blk, const SharedStatePayload& p) {
+    uint32_t odd = blk->header.seq.load(std::memory_order_relaxed) | 1u;
+    blk->header.seq.store(odd, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&blk->payload, &p, sizeof(p));
+    blk->header.seq.store(odd + 1, std::memory_order_release);
+}
+
+// 読み手：前後の seq が同じ偶数ならそのコピーは一貫している。
+// 版数が違う・書き込みが続いて maxRetry 回取れなかった場合は false
+inline bool SharedStateRead(const SharedStateBlock* blk, SharedStatePayload& out, int maxRetry = 64) {
+    if (blk->header.magic != SHARED_STATE_MAGIC || blk->header.version != SHARED_STATE_VERSION ||
+        blk->header.size < sizeof(SharedStateBlock)) return false;
+
+    for (int i = 0; i < maxRetry; ++i) {
+        uint32_t s1 = blk->header.seq.load(std::memory_order_acquire);
+        if (s1 & 1u) continue;
+        memcpy(&out, &blk->payload, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t s2 = blk->header.seq.load(std::memory_order_relaxed);
+        if (s1 == s2) return true;
+    }
+    return false;
+}
@@ -0,0 +1,228 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// ===== Volume Snapshot / Journal =====
+// 最初に触ったセッションの元の音量・ミュートを記録し、終了時などにまとめて戻す。
+// 記録はメモリマップしたジャーナルにも書くので、異常終了しても次回起動時に復元できる。
+// 終了したセッションの記録は捨て、そのスロットを再利用する。
+// Windows に依存しない部分。セッションの列挙・音量操作は SessionVolumeBackend 経由で行い、
+// 本体は WASAPI（main.cpp）、テストは偽実装を渡す。
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <functional>
+
+#define JOURNAL_MAGIC       0x4C4A5654u  // 'TVJL'
+#define JOURNAL_VERSION     1u
+#define JOURNAL_MAX_ENTRIES 256
+#define JOURNAL_SID_CHARS   512
+
+struct JournalEntry {
+    int32_t  used;    // 1 = 有効（他の項目を書いてから最後に立てる）
+    uint32_t pid;
+    float    volume;
+    int32_t  mute;
+    wchar_t  sid[JOURNAL_SID_CHARS];
+};
+
+struct JournalFile {
+    uint32_t     magic;
+    uint32_t     version;
+    int32_t      count;    // 使用中スロットの末尾+1（空きスロットは used==0 で再利用）
+    uint32_t     reserved;
+    JournalEntry entries[JOURNAL_MAX_ENTRIES];
+};
+
+struct VolumeSnapshot {
+    float   volume;
+    bool    mute;
+    int32_t slot;   // ジャーナルのスロット。-1 ならメモリ上のみ
+};
+
+// 1セッション分の音量操作
+struct SessionVolumeControl {
+    virtual ~SessionVolumeControl() {}
+    virtual bool GetVolume(float& volume, bool& mute) = 0;
+    virtual void SetVolume(float volume, bool mute) = 0;
+};
+
+// 現在のセッションを列挙し、1つずつ visit を呼ぶ
+typedef std::function<void(const std::wstring& sid, uint32_t pid, SessionVolumeControl& ctl)> SessionVolumeVisitor;
+
+struct SessionVolumeBackend {
+    virtual ~SessionVolumeBackend() {}
+    // 列挙できなかったら false（記録は消さずに残す）
+    virtual bool ForEachSession(const SessionVolumeVisitor& visit) = 0;
+    // sid がこのバックエンド（デバイス）のセッションか。
+    // 列挙に出てこなければ終了したとみなせるのは、自分のセッションだけ
+    virtual bool Owns(const std::wstring& sid) const = 0;
+};
+
+// 生存判定（DropEnded 用）
+typedef std::function<bool(const std::wstring& sid, uint32_t pid)> SessionLiveFn;
+
+struct VolumeJournal {
+    typedef void (*FlushFn)(const void* addr, size_t bytes);  // ディスクへの書き出し（省略可）
+    typedef std::pair<std::wstring, uint32_t> Key;
+    typedef std::map<Key, VolumeSnapshot> SnapshotMap;
+
+    SnapshotMap  snapshots;  // (SID,PID) → 元の状態
+    JournalFile* file;       // マップ済みジャーナル。nullptr ならメモリ上のみ
+    FlushFn      flush;
+
+    VolumeJournal() : file(nullptr), flush(nullptr) {}
+
+    // ジャーナルを結び付け、前回の残り（=異常終了）があれば snapshots へ読み戻す
+    void Attach(JournalFile* f, FlushFn fn) {
+        file = f;
+        flush = fn;
+        if (!file) return;
+
+        if (file->magic != JOURNAL_MAGIC || file->version != JOURNAL_VERSION) {
+            memset(file, 0, sizeof(JournalFile));
+            file->magic = JOURNAL_MAGIC;
+            file->version = JOURNAL_VERSION;
+            Flush(file, sizeof(JournalFile));
+            return;
+        }
+
+        // count 更新前に落ちた場合も拾えるよう、全スロットの used を見る
+        int32_t next = 0;
+        for (int32_t i = 0; i < JOURNAL_MAX_ENTRIES; ++i) {
+            JournalEntry& e = file->entries[i];
+            if (e.used != 1) continue;
+            std::wstring sid(e.sid, wcsnlen(e.sid, JOURNAL_SID_CHARS));
+            Key key(sid, e.pid);
+            if (snapshots.find(key) != snapshots.end()) { e.used = 0; continue; } // 重複は捨てる
+            snapshots[key] = VolumeSnapshot{ e.volume, e.mute != 0, i };
+            next = i + 1;
+        }
+        file->count = next;
+    }
+
+    void Detach() {
+        if (file) Flush(file, sizeof(JournalFile));
+        file = nullptr;
+        flush = nullptr;
+    }
+
+    // 初回のみ元の音量・ミュートを記録（音量を変更する直前に呼ぶ）。記録したら true
+    bool SnapshotIfFirst(const std::wstring& sid, uint32_t pid, SessionVolumeControl& ctl) {
+        if (sid.empty()) return false;
+        Key key(sid, pid);
+        if (snapshots.find(key) != snapshots.end()) return false;
+
+        VolumeSnapshot snap = { 1.0f, false, -1 };
+        if (!ctl.GetVolume(snap.volume, snap.mute)) return false;
+
+        // ジャーナルの空きスロットへ書く。SIDが長すぎる・全スロット使用中ならメモリ上のみ
+        int32_t slot = (sid.size() < JOURNAL_SID_CHARS) ? FindFreeSlot() : -1;
+        if (slot >= 0) {
+            JournalEntry& e = file->entries[slot];
+            e.used = 0;
+            e.pid = pid;
+            e.volume = snap.volume;
+            e.mute = snap.mute ? 1 : 0;
+            memcpy(e.sid, sid.c_str(), sid.size() * sizeof(wchar_t));
+            e.sid[sid.size()] = L'\0';
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            e.used = 1;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (file->count < slot + 1) file->count = slot + 1;
+            Flush(&e, sizeof(e));
+            Flush(file, sizeof(uint32_t) * 4);
+            snap.slot = slot;
+        }
+        snapshots[key] = snap;
+        return true;
+    }
+
+    // 記録済みのセッションを1回の列挙でまとめて元に戻し、その記録を消す。
+    // このバックエンドのセッションで列挙に出てこないもの（終了済み）も消すが、
+    // 他のデバイスのセッションは残す（そのデバイスへ接続したときに戻す）。
+    // 何度呼んでもよい。戻したセッション数、列挙に失敗したら -1（記録はそのまま）
+    int RestoreAll(SessionVolumeBackend& backend) {
+        if (snapshots.empty()) return 0;
+
+        std::vector<Key> restoredKeys;
+        bool ok = backend.ForEachSession([&](const std::wstring& sid, uint32_t pid, SessionVolumeControl& ctl) {
+            SnapshotMap::const_iterator it = snapshots.find(Key(sid, pid));
+            if (it == snapshots.end()) return;
+            ctl.SetVolume(it->second.volume, it->second.mute);
+            restoredKeys.push_back(it->first);
+        });
+        if (!ok) return -1;
+
+        std::set<Key> restored(restoredKeys.begin(), restoredKeys.end());
+        size_t dropped = 0;
+        for (SnapshotMap::iterator it = snapshots.begin(); it != snapshots.end();) {
+            if (restored.count(it->first) || backend.Owns(it->first.first)) {
+                ReleaseSlot(it->second.slot);
+                it = snapshots.erase(it);
+                ++dropped;
+            }
+            else {
+                ++it;
+            }
+        }
+        if (file && dropped > 0) {
+            TrimCount();
+            Flush(file, sizeof(JournalFile));
+        }
+        return (int)restored.size();
+    }
+
+    // このバックエンドのセッションのうち、もう存在しないものの記録を捨ててスロットを空ける
+    // （定期的な列挙のたびに呼ぶ。live は列挙で見つかったセッションなら true）
+    size_t DropEnded(const SessionVolumeBackend& backend, const SessionLiveFn& live) {
+        size_t dropped = 0;
+        for (SnapshotMap::iterator it = snapshots.begin(); it != snapshots.end();) {
+            if (backend.Owns(it->first.first) && !live(it->first.first, it->first.second)) {
+                ReleaseSlot(it->second.slot);
+                it = snapshots.erase(it);
+                ++dropped;
+            }
+            else {
+                ++it;
+            }
+        }
+        if (file && dropped > 0) {
+            TrimCount();
+            Flush(file, sizeof(JournalFile));
+        }
+        return dropped;
+    }
+
+private:
+    void Flush(const void* addr, size_t bytes) {
+        if (flush) flush(addr, bytes);
+    }
+
+    int32_t FindFreeSlot() const {
+        if (!file) return -1;
+        for (int32_t i = 0; i < JOURNAL_MAX_ENTRIES; ++i) {
+            if (file->entries[i].used == 0) return i;
+        }
+        return -1;
+    }
+
+    void ReleaseSlot(int32_t slot) {
+        if (!file || slot < 0 || slot >= JOURNAL_MAX_ENTRIES) return;
+        file->entries[slot].used = 0;
+    }
+
+    // 末尾の空きスロットを count から外す
+    void TrimCount() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int32_t n = (file->count > JOURNAL_MAX_ENTRIES) ? JOURNAL_MAX_ENTRIES : file->count;
+        while (n > 0 && file->entries[n - 1].used != 1) --n;
+        file->count = n;
+    }
+};
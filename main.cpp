@@ -1,4 +1,4 @@
-﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
 
 #define _WIN32_WINNT 0x0A00
 #include <windows.h>
@@ -12,6 +12,11 @@
 #include <algorithm>
 #include <map>
 
+#include "AppRules.h"
+#include "VolumeJournal.h"
+#include "PeakMeter.h"
+#include "SharedState.h"
+
 #pragma comment(lib, "Ole32.lib")
 #pragma comment(lib, "Uuid.lib")
 #pragma comment(lib, "Comctl32.lib")
@@ -25,6 +30,7 @@ const wchar_t WINDOW_NAME[] = L"同時参加音量バランサー";
 int   g_controlMode = MODE_CENTER_MAX; // 既定：CENTER MAX
 HWND  g_radioMax = nullptr;
 HWND  g_radioHalf = nullptr;
+HWND  g_btnRestore = nullptr;
 
 #define DEVICE_ROLE eMultimedia
 
@@ -37,15 +43,14 @@ HWND  g_radioHalf = nullptr;
 #define IDC_TRACK       1003
 #define IDC_RAD_MAX     1004   // 「CENTER MAX」
 #define IDC_RAD_HALF    1005   // 「CENTER HALF」
+#define IDC_BTN_RESTORE 1006   // 「音量を元に戻す」
+#define TIMER_METER     2      // メーター更新（1 はポーリング）
 #define WMAPP_REFRESH   (WM_APP + 1)
+#define WMAPP_DEVICE_CHANGED (WM_APP + 2)   // wParam: DEVICE_CHANGE_*
+#define DEVICE_CHANGE_DEFAULT 0   // 既定デバイスが変わった（NULL＝出力デバイスが無くなった場合も）
+#define DEVICE_CHANGE_ACTIVE  1   // いずれかのデバイスが有効になった
 
 // ===== Helpers =====
-static std::wstring ToLower(const std::wstring& s) {
-    std::wstring t = s;
-    for (size_t i = 0; i < t.size(); ++i) t[i] = (wchar_t)towlower(t[i]);
-    return t;
-}
-
 // DisplayName が空の時、SessionID から "xxx.exe" を推定
 static std::wstring NormalizeNameFromSessionId(const std::wstring& sid) {
     if (sid.empty()) return L"unknown";
@@ -53,7 +58,7 @@ static std::wstring NormalizeNameFromSessionId(const std::wstring& sid) {
     std::wstring tail = (sep == std::wstring::npos) ? sid : sid.substr(sep + 1);
     size_t cut1 = tail.find_first_of(L"% \t\r\n");
     if (cut1 != std::wstring::npos) tail = tail.substr(0, cut1);
-    std::wstring lower = ToLower(tail);
+    std::wstring lower = AppRuleToLower(tail);
     size_t exep = lower.find(L".exe");
     if (exep != std::wstring::npos) tail = tail.substr(0, exep + 4);
     if (tail.empty()) return L"unknown";
@@ -86,6 +91,7 @@ HFONT                   g_hFontCombo = nullptr;
 IMMDeviceEnumerator* g_pEnumerator = nullptr;
 IMMDevice* g_pDevice = nullptr;
 IAudioSessionManager2* g_pSessionMgr2 = nullptr;
+std::wstring g_deviceId;  // 接続中デバイスのID（音量記録の所属判定用）
 
 std::vector<SessionEntry> g_sessions;
 std::set<std::wstring>     g_registeredSids;  // 現在イベント登録済みSID（列挙で置換）
@@ -95,6 +101,9 @@ std::wstring               g_selectedSidB;     // 選択保持（SID）
 DWORD                      g_selectedPidA = 0;
 DWORD                      g_selectedPidB = 0;
 
+AppRuleSet                 g_rules;           // ルールファイルから構築した照合器
+std::map<std::pair<std::wstring, DWORD>, int> g_ruleBySession; // (SID,PID) → 照合済みルール番号（-1=該当なし）
+
 // 前方宣言
 struct SessionWatcher;
 static void RefreshSessionsAndUI(BOOL keepSelection);
@@ -179,9 +188,339 @@ struct SessionWatcher : IAudioSessionEvents, IAudioSessionNotification {
 
 SessionWatcher* g_pWatcher = nullptr;
 
+// ===== Device Watcher =====
+// 既定デバイス変更を UI スレッドへ通知するだけ
+struct DeviceWatcher : IMMNotificationClient {
+    LONG m_ref;
+    HWND m_hNotify;
+
+    explicit DeviceWatcher(HWND hWnd) : m_ref(1), m_hNotify(hWnd) {}
+
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override {
+        if (!ppv) return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IMMNotificationClient)) {
+            *ppv = static_cast<IMMNotificationClient*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return (ULONG)InterlockedIncrement(&m_ref); }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG r = (ULONG)InterlockedDecrement(&m_ref);
+        if (r == 0) delete this;
+        return r;
+    }
+
+    // 対象ロールの出力既定デバイスが変わった
+    HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR) override {
+        if (flow == eRender && role == DEVICE_ROLE) PostMessage(m_hNotify, WMAPP_DEVICE_CHANGED, DEVICE_CHANGE_DEFAULT, 0);
+        return S_OK;
+    }
+
+    // デバイスが有効になった（未接続なら再試行のきっかけにする）
+    HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD newState) override {
+        if (newState == DEVICE_STATE_ACTIVE) PostMessage(m_hNotify, WMAPP_DEVICE_CHANGED, DEVICE_CHANGE_ACTIVE, 0);
+        return S_OK;
+    }
+
+    // 未使用
+    HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override { return S_OK; }
+};
+
+DeviceWatcher* g_pDeviceWatcher = nullptr;
+
+// ===== Shared State Publication =====
+// 外部ツール（配信オーバーレイ・監視）向けに現在状態を共有メモリへ公開（レイアウトは SharedState.h）
+#define SHARED_STATE_WRITER_MUTEX L"Local\\TwoAppVolumeBalancer.StateWriter"  // 書き手の多重起動検出
+
+HANDLE            g_hSharedStateWriter = nullptr;
+HANDLE            g_hSharedState = nullptr;
+SharedStateBlock* g_pSharedState = nullptr;
+float             g_appliedGainA = 1.0f;  // 直近に適用した A/B の音量
+float             g_appliedGainB = 1.0f;
+bool              g_gainsApplied = false; // 復元後は false
+
+static void CloseSharedState();
+
+static void OpenSharedState() {
+    // 別インスタンスが書き手なら公開しない（seqlock は書き手1つが前提）。
+    // 共有メモリ自体は読み手が開いている間残るので、その有無では判定しない
+    g_hSharedStateWriter = CreateMutexW(nullptr, FALSE, SHARED_STATE_WRITER_MUTEX);
+    if (!g_hSharedStateWriter) return;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(g_hSharedStateWriter); g_hSharedStateWriter = nullptr;
+        return;
+    }
+
+    // 前回の書き手が残したブロック（読み手が開いたまま）でもそのまま引き継ぐ
+    g_hSharedState = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        0, sizeof(SharedStateBlock), SHARED_STATE_NAME);
+    if (g_hSharedState) {
+        g_pSharedState = (SharedStateBlock*)MapViewOfFile(g_hSharedState, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedStateBlock));
+    }
+    if (!g_pSharedState) { CloseSharedState(); return; }
+    SharedStateInit(g_pSharedState); // 新規作成のページはゼロ初期化済み
+}
+
+// 書き手がいなくなったことを示すため、選択・適用フラグを落としてから閉じる
+static void CloseSharedState() {
+    if (g_pSharedState) {
+        SharedStatePayload p = {};
+        p.mode = (uint32_t)g_controlMode;
+        p.position = g_track ? (int32_t)SendMessage(g_track, TBM_GETPOS, 0, 0) : 50;
+        SharedStateWrite(g_pSharedState, p);
+        UnmapViewOfFile(g_pSharedState); g_pSharedState = nullptr;
+    }
+    if (g_hSharedState) { CloseHandle(g_hSharedState); g_hSharedState = nullptr; }
+    if (g_hSharedStateWriter) { CloseHandle(g_hSharedStateWriter); g_hSharedStateWriter = nullptr; }
+}
+
+static void FillSharedSession(SharedSessionState& dst, const std::wstring& sid, DWORD pid, float gain) {
+    dst.pid = pid;
+    dst.gain = gain;
+    std::wstring name;
+    for (size_t i = 0; i < g_sessions.size(); ++i) {
+        if (g_sessions[i].sid == sid && g_sessions[i].pid == pid) { name = g_sessions[i].name; break; }
+    }
+    size_t n = (name.size() < SHARED_STATE_NAME_CHARS - 1) ? name.size() : SHARED_STATE_NAME_CHARS - 1;
+    for (size_t i = 0; i < n; ++i) dst.name[i] = (uint16_t)name[i];
+    dst.name[n] = 0;
+}
+
+// UIスレッドからのみ呼ぶ（書き手は1つ）
+static void PublishSharedState() {
+    if (!g_pSharedState) return;
+
+    SharedStatePayload p = {};
+    p.mode = (uint32_t)g_controlMode;
+    p.position = g_track ? (int32_t)SendMessage(g_track, TBM_GETPOS, 0, 0) : 50;
+    if (!g_selectedSidA.empty()) {
+        p.flags |= SHARED_STATE_HAS_A;
+        FillSharedSession(p.a, g_selectedSidA, g_selectedPidA, g_appliedGainA);
+    }
+    if (!g_selectedSidB.empty()) {
+        p.flags |= SHARED_STATE_HAS_B;
+        FillSharedSession(p.b, g_selectedSidB, g_selectedPidB, g_appliedGainB);
+    }
+    if (g_gainsApplied) p.flags |= SHARED_STATE_APPLIED;
+
+    SharedStateWrite(g_pSharedState, p);
+}
+
+// ===== Volume Snapshot / Journal (WASAPI 側) =====
+// 記録・復元の本体は VolumeJournal.h。ここではジャーナルファイルと WASAPI をつなぐだけ
+#define JOURNAL_FILE_NAME   L"TwoAppVolumeBalancer.journal"
+
+struct SimpleVolumeControl : SessionVolumeControl {
+    ISimpleAudioVolume* m_pVol;
+
+    explicit SimpleVolumeControl(ISimpleAudioVolume* pVol) : m_pVol(pVol) {}
+
+    bool GetVolume(float& volume, bool& mute) override {
+        if (FAILED(m_pVol->GetMasterVolume(&volume))) return false;
+        BOOL m = FALSE;
+        if (FAILED(m_pVol->GetMute(&m))) m = FALSE;
+        mute = (m != FALSE);
+        return true;
+    }
+    void SetVolume(float volume, bool mute) override {
+        m_pVol->SetMasterVolume(volume, nullptr);
+        m_pVol->SetMute(mute ? TRUE : FALSE, nullptr);
+    }
+};
+
+// 現在のデバイスのセッションを1回の列挙で巡回
+struct WasapiVolumeBackend : SessionVolumeBackend {
+    IAudioSessionManager2* m_mgr;
+    std::wstring           m_deviceId;  // セッションIDは "<デバイスID>|..." の形
+
+    WasapiVolumeBackend(IAudioSessionManager2* mgr, const std::wstring& deviceId) : m_mgr(mgr), m_deviceId(deviceId) {}
+
+    // デバイスが抜かれた後などで列挙できなければ false
+    bool ForEachSession(const SessionVolumeVisitor& visit) override {
+        IAudioSessionEnumerator* pEnum = nullptr;
+        if (!m_mgr || FAILED(m_mgr->GetSessionEnumerator(&pEnum)) || !pEnum) return false;
+
+        int count = 0;
+        if (FAILED(pEnum->GetCount(&count))) { pEnum->Release(); return false; }
+
+        for (int i = 0; i < count; ++i) {
+            IAudioSessionControl* pCtrl = nullptr;
+            IAudioSessionControl2* pCtrl2 = nullptr;
+            ISimpleAudioVolume* pVol = nullptr;
+
+            if (FAILED(pEnum->GetSession(i, &pCtrl)) || !pCtrl) continue;
+            if (FAILED(pCtrl->QueryInterface(IID_PPV_ARGS(&pCtrl2))) || !pCtrl2) { pCtrl->Release(); continue; }
+
+            LPWSTR wsid = nullptr;
+            std::wstring key;
+            if (SUCCEEDED(pCtrl2->GetSessionIdentifier(&wsid)) && wsid) {
+                key = wsid; CoTaskMemFree(wsid);
+            }
+            DWORD pid = 0; pCtrl2->GetProcessId(&pid);
+
+            if (!key.empty() && SUCCEEDED(pCtrl->QueryInterface(IID_PPV_ARGS(&pVol))) && pVol) {
+                SimpleVolumeControl ctl(pVol);
+                visit(key, pid, ctl);
+                pVol->Release();
+            }
+
+            pCtrl2->Release();
+            pCtrl->Release();
+        }
+        pEnum->Release();
+        return true;
+    }
+
+    // デバイスIDが取れなかったときは、すべて現在のデバイスのセッションとみなす
+    bool Owns(const std::wstring& sid) const override {
+        return sid.compare(0, m_deviceId.size(), m_deviceId) == 0;
+    }
+};
+
+VolumeJournal g_volumeJournal;
+HANDLE        g_hJournalFile = INVALID_HANDLE_VALUE;
+HANDLE        g_hJournalMap = nullptr;
+JournalFile*  g_pJournal = nullptr;
+
+static void FlushJournalView(const void* addr, size_t bytes) {
+    FlushViewOfFile(addr, bytes);
+}
+
+// ジャーナルを開き、前回の残り（=異常終了）があれば読み戻す（開けなければメモリ上のみ）
+static void OpenVolumeJournal() {
+    wchar_t dir[MAX_PATH] = { 0 };
+    DWORD len = GetTempPathW(MAX_PATH, dir);
+    if (len > 0 && len < MAX_PATH) {
+        std::wstring path = std::wstring(dir) + JOURNAL_FILE_NAME;
+        g_hJournalFile = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+    if (g_hJournalFile != INVALID_HANDLE_VALUE) {
+        g_hJournalMap = CreateFileMappingW(g_hJournalFile, nullptr, PAGE_READWRITE, 0, sizeof(JournalFile), nullptr);
+        if (g_hJournalMap) {
+            g_pJournal = (JournalFile*)MapViewOfFile(g_hJournalMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(JournalFile));
+        }
+        if (!g_pJournal) {
+            if (g_hJournalMap) { CloseHandle(g_hJournalMap); g_hJournalMap = nullptr; }
+            CloseHandle(g_hJournalFile); g_hJournalFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    g_volumeJournal.Attach(g_pJournal, FlushJournalView);
+}
+
+static void CloseVolumeJournal() {
+    g_volumeJournal.Detach();
+    if (g_pJournal) { UnmapViewOfFile(g_pJournal); g_pJournal = nullptr; }
+    if (g_hJournalMap) { CloseHandle(g_hJournalMap); g_hJournalMap = nullptr; }
+    if (g_hJournalFile != INVALID_HANDLE_VALUE) { CloseHandle(g_hJournalFile); g_hJournalFile = INVALID_HANDLE_VALUE; }
+}
+
+// 初回のみ元の音量・ミュートを記録（音量を変更する直前に呼ぶ）
+static void SnapshotVolumeIfFirst(ISimpleAudioVolume* pVol, const std::wstring& sid, DWORD pid) {
+    if (!pVol) return;
+    SimpleVolumeControl ctl(pVol);
+    g_volumeJournal.SnapshotIfFirst(sid, pid, ctl);
+}
+
+// 記録済みの全セッションをまとめて元に戻す。何度呼んでもよい。
+// デバイスが無い・列挙できない間は記録を残す（終了してもジャーナル経由で次回復元）。
+// 他のデバイスのセッションの記録は、そのデバイスへ接続したときに戻す
+static void RestoreAllSessionVolumes() {
+    if (g_volumeJournal.snapshots.empty() || !g_pSessionMgr2) return;
+
+    WasapiVolumeBackend backend(g_pSessionMgr2, g_deviceId);
+    int restored = g_volumeJournal.RestoreAll(backend);
+
+#ifdef _DEBUG
+    std::wstring dbg = (restored < 0) ? std::wstring(L"Restore volumes: enumeration failed, kept journal\n")
+        : L"Restored volumes: " + std::to_wstring(restored) + L" session(s)\n";
+    OutputDebugStringW(dbg.c_str());
+#endif
+    if (restored < 0) return;
+
+    g_gainsApplied = false;
+    PublishSharedState();
+}
+
+
+// ===== App Rules: load / apply =====
+// 実行ファイルと同じ場所の "<exe名>.rules"（UTF-8）を読み込む。無ければルールなし
+static void LoadAppRules() {
+    wchar_t path[MAX_PATH] = { 0 };
+    DWORD len = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (len == 0 || len >= MAX_PATH) return;
+    std::wstring rulesPath = path;
+    size_t dot = rulesPath.find_last_of(L'.');
+    size_t sep = rulesPath.find_last_of(L"\\/");
+    if (dot != std::wstring::npos && (sep == std::wstring::npos || dot > sep)) rulesPath.erase(dot);
+    rulesPath += L".rules";
+
+    HANDLE hFile = CreateFileW(rulesPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    std::string bytes;
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0 && size.QuadPart < (1 << 24)) {
+        bytes.resize((size_t)size.QuadPart);
+        DWORD read = 0;
+        if (!ReadFile(hFile, &bytes[0], (DWORD)bytes.size(), &read, nullptr)) read = 0;
+        bytes.resize(read);
+    }
+    CloseHandle(hFile);
+
+    // UTF-8 BOM を除去してワイド文字へ
+    size_t skip = (bytes.size() >= 3 && bytes.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+    std::wstring text;
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, bytes.data() + skip, (int)(bytes.size() - skip), nullptr, 0);
+    if (wlen > 0) {
+        text.resize(wlen);
+        MultiByteToWideChar(CP_UTF8, 0, bytes.data() + skip, (int)(bytes.size() - skip), &text[0], wlen);
+    }
+
+    CompileAppRules(text, g_rules);
+
+#ifdef _DEBUG
+    std::wstring dbg = L"Rules loaded: " + std::to_wstring(g_rules.rules.size()) + L" (" + rulesPath + L")\n";
+    OutputDebugStringW(dbg.c_str());
+#endif
+}
+
+// 新規セッションに初期音量を設定
+static void ApplyRuleGain(IAudioSessionControl* pCtrl, const std::wstring& sid, DWORD pid, float gain) {
+    ISimpleAudioVolume* pVol = nullptr;
+    if (SUCCEEDED(pCtrl->QueryInterface(IID_PPV_ARGS(&pVol))) && pVol) {
+        SnapshotVolumeIfFirst(pVol, sid, pid);
+        pVol->SetMasterVolume(gain, nullptr);
+        pVol->Release();
+    }
+}
+
+// ルールで A/B に割り当てる。現在の選択が空か、もう存在しない場合のみ上書き
+static bool AssignRuleSide(const SessionEntry* candidate, std::wstring& sidVar, DWORD& pidVar,
+                           const std::wstring& otherSid, DWORD otherPid) {
+    if (!candidate) return false;
+    if (candidate->sid == otherSid && candidate->pid == otherPid) return false;
+    if (!sidVar.empty()) {
+        for (size_t i = 0; i < g_sessions.size(); ++i) {
+            if (g_sessions[i].sid == sidVar && g_sessions[i].pid == pidVar) return false;
+        }
+    }
+    sidVar = candidate->sid;
+    pidVar = candidate->pid;
+    return true;
+}
 
 // ===== Core: Enumerate & Register events. Return "changed?" =====
-static bool BuildSessionListAndRegisterAndGetChanged() {
+// ruleAssigned: ルールにより A/B の選択が変わったら true
+static bool BuildSessionListAndRegisterAndGetChanged(bool& ruleAssigned) {
+    ruleAssigned = false;
     g_sessions.clear();
     if (!g_pSessionMgr2) return false;
 
@@ -192,14 +531,18 @@ static bool BuildSessionListAndRegisterAndGetChanged() {
     if (FAILED(pEnum->GetCount(&count))) { pEnum->Release(); return false; }
 
     std::set<std::wstring> currentSids;
+    std::set<std::pair<std::wstring, DWORD>> currentSessions;
+    bool complete = true;  // 全セッションを取得できたか（取りこぼしがあれば記録は捨てない）
+    SessionEntry ruleA = {}, ruleB = {};
+    int ruleIndexA = -1, ruleIndexB = -1;  // 候補のルール番号（小さいほど優先）
 
     for (int i = 0; i < count; ++i) {
         IAudioSessionControl* pCtrl = nullptr;
         IAudioSessionControl2* pCtrl2 = nullptr;
 
-        if (FAILED(pEnum->GetSession(i, &pCtrl)) || !pCtrl) continue;
+        if (FAILED(pEnum->GetSession(i, &pCtrl)) || !pCtrl) { complete = false; continue; }
         if (FAILED(pCtrl->QueryInterface(IID_PPV_ARGS(&pCtrl2))) || !pCtrl2) {
-            pCtrl->Release(); continue;
+            pCtrl->Release(); complete = false; continue;
         }
 
         // SID
@@ -209,6 +552,7 @@ static bool BuildSessionListAndRegisterAndGetChanged() {
             key = sid; CoTaskMemFree(sid);
         }
         if (!key.empty()) currentSids.insert(key);
+        else complete = false;
 
         // セッションイベント未登録なら登録
         if (!key.empty() && g_pWatcher) {
@@ -227,7 +571,28 @@ static bool BuildSessionListAndRegisterAndGetChanged() {
 
         DWORD pid = 0; pCtrl2->GetProcessId(&pid);
 
-        g_sessions.push_back(SessionEntry{ key, name, pid });
+        // ルール照合は新規セッションにつき一度だけ（結果はキャッシュ）
+        std::pair<std::wstring, DWORD> sessionKey(key, pid);
+        currentSessions.insert(sessionKey);
+        std::map<std::pair<std::wstring, DWORD>, int>::iterator ruleIt = g_ruleBySession.find(sessionKey);
+        bool firstSeen = (ruleIt == g_ruleBySession.end());
+        if (firstSeen) {
+            int ri = MatchAppRule(g_rules, NormalizeNameFromSessionId(key), name);
+            ruleIt = g_ruleBySession.insert(std::make_pair(sessionKey, ri)).first;
+        }
+        const AppRule* rule = (ruleIt->second >= 0) ? &g_rules.rules[ruleIt->second] : nullptr;
+
+        if (rule && firstSeen && !key.empty()) {
+            if (rule->gain >= 0.0f) ApplyRuleGain(pCtrl, key, pid, rule->gain);
+            // 同じ列挙で複数一致したら、上の行のルールに一致したセッションを採用
+            int ri = ruleIt->second;
+            if (rule->side == RULE_SIDE_A && (ruleIndexA < 0 || ri < ruleIndexA)) { ruleA = SessionEntry{ key, name, pid }; ruleIndexA = ri; }
+            if (rule->side == RULE_SIDE_B && (ruleIndexB < 0 || ri < ruleIndexB)) { ruleB = SessionEntry{ key, name, pid }; ruleIndexB = ri; }
+        }
+
+        if (!rule || !rule->ignore) {
+            g_sessions.push_back(SessionEntry{ key, name, pid });
+        }
 
 		// デバッグ出力
         
@@ -251,6 +616,24 @@ static bool BuildSessionListAndRegisterAndGetChanged() {
     std::sort(g_sessions.begin(), g_sessions.end(),
         [](const SessionEntry& a, const SessionEntry& b) { return a.name < b.name; });
 
+    // 消えたセッションの照合結果を破棄（再出現時に再照合）
+    for (std::map<std::pair<std::wstring, DWORD>, int>::iterator it = g_ruleBySession.begin(); it != g_ruleBySession.end();) {
+        if (currentSessions.find(it->first) == currentSessions.end()) it = g_ruleBySession.erase(it);
+        else ++it;
+    }
+
+    // 終了したセッションの音量記録を捨て、ジャーナルのスロットを空ける
+    if (complete && !g_volumeJournal.snapshots.empty()) {
+        WasapiVolumeBackend backend(g_pSessionMgr2, g_deviceId);
+        g_volumeJournal.DropEnded(backend, [&](const std::wstring& sid, uint32_t pid) {
+            return currentSessions.find(std::make_pair(sid, (DWORD)pid)) != currentSessions.end();
+        });
+    }
+
+    // ルールによる A/B 自動割り当て
+    if (AssignRuleSide(ruleIndexA >= 0 ? &ruleA : nullptr, g_selectedSidA, g_selectedPidA, g_selectedSidB, g_selectedPidB)) ruleAssigned = true;
+    if (AssignRuleSide(ruleIndexB >= 0 ? &ruleB : nullptr, g_selectedSidB, g_selectedPidB, g_selectedSidA, g_selectedPidA)) ruleAssigned = true;
+
     // 現在の集合で置換（再出現時に再登録できるようにする）
     g_registeredSids = currentSids;
 
@@ -355,15 +738,17 @@ static void RepopulateCombos(BOOL keepSelection) {
 
 // ===== Set volume of a session by PID =====
 // 旧: SetSessionVolumeBySid(sid, volume)
-// 新:
-static void SetSessionVolumeBySidPid(const std::wstring& sid, DWORD pid, float volume01) {
-    if (sid.empty() || !g_pSessionMgr2) return;
+// 新: 設定できたら true
+static bool SetSessionVolumeBySidPid(const std::wstring& sid, DWORD pid, float volume01) {
+    if (sid.empty() || !g_pSessionMgr2) return false;
 
     IAudioSessionEnumerator* pEnum = nullptr;
-    if (FAILED(g_pSessionMgr2->GetSessionEnumerator(&pEnum)) || !pEnum) return;
+    if (FAILED(g_pSessionMgr2->GetSessionEnumerator(&pEnum)) || !pEnum) return false;
 
     int count = 0;
-    if (FAILED(pEnum->GetCount(&count))) { pEnum->Release(); return; }
+    if (FAILED(pEnum->GetCount(&count))) { pEnum->Release(); return false; }
+
+    bool applied = false;
 
     for (int i = 0; i < count; ++i) {
         IAudioSessionControl* pCtrl = nullptr;
@@ -384,7 +769,8 @@ static void SetSessionVolumeBySidPid(const std::wstring& sid, DWORD pid, float v
             if (SUCCEEDED(pCtrl->QueryInterface(IID_PPV_ARGS(&pVol))) && pVol) {
                 if (volume01 < 0.0f) volume01 = 0.0f;
                 else if (volume01 > 1.0f) volume01 = 1.0f;
-                pVol->SetMasterVolume(volume01, nullptr);
+                SnapshotVolumeIfFirst(pVol, key, curPid);
+                applied = SUCCEEDED(pVol->SetMasterVolume(volume01, nullptr));
                 pVol->Release();
             }
             pCtrl2->Release();
@@ -396,6 +782,7 @@ static void SetSessionVolumeBySidPid(const std::wstring& sid, DWORD pid, float v
         pCtrl->Release();
     }
     pEnum->Release();
+    return applied;
 }
 
 
@@ -416,7 +803,11 @@ static void ApplyBalanceFromTrackbar() {
     }
 
 
-    if (g_selectedSidA.empty() || g_selectedSidB.empty()) return;
+    if (g_selectedSidA.empty() || g_selectedSidB.empty()) {
+        g_gainsApplied = false; // 以前のペアの音量は今の選択には当てはまらない
+        PublishSharedState();   // 片側だけの選択も公開
+        return;
+    }
 
     int pos = (int)SendMessage(g_track, TBM_GETPOS, 0, 0);
     if (pos < 0) pos = 0; else if (pos > 100) pos = 100;
@@ -452,26 +843,237 @@ static void ApplyBalanceFromTrackbar() {
 		break; // 何もしない
     }
 
-    SetSessionVolumeBySidPid(g_selectedSidA, g_selectedPidA, b);
-    SetSessionVolumeBySidPid(g_selectedSidB, g_selectedPidB, a);
+    bool appliedA = SetSessionVolumeBySidPid(g_selectedSidA, g_selectedPidA, b);
+    bool appliedB = SetSessionVolumeBySidPid(g_selectedSidB, g_selectedPidB, a);
+
+    // 両方に書けたときだけ「適用済み」として公開
+    g_appliedGainA = b;
+    g_appliedGainB = a;
+    g_gainsApplied = appliedA && appliedB;
+    PublishSharedState();
+}
+
+// ===== Level Meters =====
+struct MeterSlot {
+    IAudioMeterInformation* pMeter;
+    std::wstring sid;   // 取得対象（見つからなくても記録し、毎フレーム列挙しない）
+    DWORD        pid;
+    bool         bound;
+    PeakMeter    meter;
+    RECT         rc;    // メインウィンドウ上の描画位置
+};
+
+MeterSlot g_meterA = { nullptr, L"", 0, false, {}, {} };
+MeterSlot g_meterB = { nullptr, L"", 0, false, {}, {} };
+HDC       g_hMeterDC = nullptr;   // オフスクリーン描画用
+HBITMAP   g_hMeterBmp = nullptr;
+HBITMAP   g_hMeterBmpOld = nullptr;
+int       g_meterBufW = 0, g_meterBufH = 0;
+
+static void ReleaseMeterSlot(MeterSlot& slot) {
+    if (slot.pMeter) { slot.pMeter->Release(); slot.pMeter = nullptr; }
+    slot.bound = false;
+}
+
+// セッション一覧が変わった・デバイスが変わった時に呼ぶ（次フレームで取り直す）
+static void ReleaseMeters() {
+    ReleaseMeterSlot(g_meterA);
+    ReleaseMeterSlot(g_meterB);
+}
+
+// 選択が変わった側だけ、1回の列挙で IAudioMeterInformation を取り直す
+static void BindMeters() {
+    bool needA = !g_meterA.bound || g_meterA.sid != g_selectedSidA || g_meterA.pid != g_selectedPidA;
+    bool needB = !g_meterB.bound || g_meterB.sid != g_selectedSidB || g_meterB.pid != g_selectedPidB;
+    if (!needA && !needB) return;
+
+    // 別セッションに切り替わる側は前のアプリのピークを残さない（次フレームで必ず再描画）
+    if (needA) {
+        ReleaseMeterSlot(g_meterA);
+        g_meterA.sid = g_selectedSidA; g_meterA.pid = g_selectedPidA; g_meterA.bound = true;
+        PeakMeterReset(g_meterA.meter);
+        g_meterA.meter.barPx = g_meterA.meter.holdPx = -1;
+    }
+    if (needB) {
+        ReleaseMeterSlot(g_meterB);
+        g_meterB.sid = g_selectedSidB; g_meterB.pid = g_selectedPidB; g_meterB.bound = true;
+        PeakMeterReset(g_meterB.meter);
+        g_meterB.meter.barPx = g_meterB.meter.holdPx = -1;
+    }
+    needA = needA && !g_meterA.sid.empty();
+    needB = needB && !g_meterB.sid.empty();
+    if ((!needA && !needB) || !g_pSessionMgr2) return;
+
+    IAudioSessionEnumerator* pEnum = nullptr;
+    if (FAILED(g_pSessionMgr2->GetSessionEnumerator(&pEnum)) || !pEnum) return;
+
+    int count = 0;
+    if (FAILED(pEnum->GetCount(&count))) count = 0;
+
+    for (int i = 0; i < count && (needA || needB); ++i) {
+        IAudioSessionControl* pCtrl = nullptr;
+        IAudioSessionControl2* pCtrl2 = nullptr;
+
+        if (FAILED(pEnum->GetSession(i, &pCtrl)) || !pCtrl) continue;
+        if (FAILED(pCtrl->QueryInterface(IID_PPV_ARGS(&pCtrl2))) || !pCtrl2) { pCtrl->Release(); continue; }
+
+        LPWSTR wsid = nullptr;
+        std::wstring key;
+        if (SUCCEEDED(pCtrl2->GetSessionIdentifier(&wsid)) && wsid) {
+            key = wsid; CoTaskMemFree(wsid);
+        }
+        DWORD pid = 0; pCtrl2->GetProcessId(&pid);
+
+        if (needA && key == g_meterA.sid && pid == g_meterA.pid) {
+            pCtrl->QueryInterface(IID_PPV_ARGS(&g_meterA.pMeter));
+            needA = false;
+        }
+        else if (needB && key == g_meterB.sid && pid == g_meterB.pid) {
+            pCtrl->QueryInterface(IID_PPV_ARGS(&g_meterB.pMeter));
+            needB = false;
+        }
+
+        pCtrl2->Release();
+        pCtrl->Release();
+    }
+    pEnum->Release();
+}
+
+// 1フレーム分：両セッションのピークをまとめて読み、変化したメーター矩形だけ無効化
+static void SampleMetersFrame(HWND hWnd) {
+    BindMeters();
+
+    float peakA = 0.0f, peakB = 0.0f;
+    if (g_meterA.pMeter && FAILED(g_meterA.pMeter->GetPeakValue(&peakA))) peakA = 0.0f;
+    if (g_meterB.pMeter && FAILED(g_meterB.pMeter->GetPeakValue(&peakB))) peakB = 0.0f;
+
+    PeakMeterUpdate(g_meterA.meter, PeakToMeterScale(peakA));
+    PeakMeterUpdate(g_meterB.meter, PeakToMeterScale(peakB));
+
+    if (PeakMeterNeedsRepaint(g_meterA.meter, g_meterA.rc.right - g_meterA.rc.left - 2)) {
+        InvalidateRect(hWnd, &g_meterA.rc, FALSE);
+    }
+    if (PeakMeterNeedsRepaint(g_meterB.meter, g_meterB.rc.right - g_meterB.rc.left - 2)) {
+        InvalidateRect(hWnd, &g_meterB.rc, FALSE);
+    }
+
+#ifdef _DEBUG
+    // メーター動作中のプロセスCPU使用率（1コア比）を5秒ごとに出力
+    static int frames = 0;
+    static ULONGLONG lastTick = 0, lastCpu = 0;
+    if (++frames >= METER_FPS * 5) {
+        FILETIME ftC, ftE, ftK, ftU;
+        if (GetProcessTimes(GetCurrentProcess(), &ftC, &ftE, &ftK, &ftU)) {
+            ULONGLONG cpu = (((ULONGLONG)ftK.dwHighDateTime << 32) | ftK.dwLowDateTime) +
+                            (((ULONGLONG)ftU.dwHighDateTime << 32) | ftU.dwLowDateTime); // 100ns
+            ULONGLONG tick = GetTickCount64();
+            if (lastTick != 0 && tick > lastTick) {
+                double percent = (double)(cpu - lastCpu) / 10000.0 / (double)(tick - lastTick) * 100.0;
+                wchar_t dbg[96];
+                _snwprintf_s(dbg, _TRUNCATE, L"Meter CPU: %.2f%%\n", percent);
+                OutputDebugStringW(dbg);
+            }
+            lastTick = tick;
+            lastCpu = cpu;
+        }
+        frames = 0;
+    }
+#endif
+}
+
+// オフスクリーンに1本描いてから画面へ転送
+static void PaintMeter(HDC hdc, const MeterSlot& slot) {
+    int w = slot.rc.right - slot.rc.left;
+    int h = slot.rc.bottom - slot.rc.top;
+    if (w <= 0 || h <= 0) return;
+
+    if (!g_hMeterDC || w > g_meterBufW || h > g_meterBufH) {
+        if (g_hMeterDC) {
+            SelectObject(g_hMeterDC, g_hMeterBmpOld);
+            DeleteObject(g_hMeterBmp);
+            DeleteDC(g_hMeterDC);
+        }
+        g_hMeterDC = CreateCompatibleDC(hdc);
+        g_hMeterBmp = CreateCompatibleBitmap(hdc, w, h);
+        g_hMeterBmpOld = (HBITMAP)SelectObject(g_hMeterDC, g_hMeterBmp);
+        g_meterBufW = w;
+        g_meterBufH = h;
+    }
+
+    RECT r = { 0, 0, w, h };
+    FillRect(g_hMeterDC, &r, (HBRUSH)GetStockObject(GRAY_BRUSH));
+    RECT inner = { 1, 1, w - 1, h - 1 };
+    FillRect(g_hMeterDC, &inner, g_hbrBackground);
+
+    const int maxPx = w - 2;
+    int bar = slot.meter.barPx > maxPx ? maxPx : slot.meter.barPx;
+    int hold = slot.meter.holdPx > maxPx ? maxPx : slot.meter.holdPx;
+
+    // バー（-6dB 以上は赤で表示）
+    COLORREF prevBk = SetBkColor(g_hMeterDC, RGB(0, 176, 80));
+    int redFrom = (int)(maxPx * (1.0f - 6.0f / METER_RANGE_DB));
+    RECT rb = { 1, 1, 1 + (bar < redFrom ? bar : redFrom), h - 1 };
+    ExtTextOutW(g_hMeterDC, 0, 0, ETO_OPAQUE, &rb, nullptr, 0, nullptr);
+    if (bar > redFrom) {
+        SetBkColor(g_hMeterDC, RGB(220, 40, 40));
+        RECT rr = { 1 + redFrom, 1, 1 + bar, h - 1 };
+        ExtTextOutW(g_hMeterDC, 0, 0, ETO_OPAQUE, &rr, nullptr, 0, nullptr);
+    }
+    // ピークホールド線
+    if (hold > 0) {
+        SetBkColor(g_hMeterDC, RGB(64, 64, 64));
+        RECT rh = { hold, 1, hold + 1, h - 1 };
+        ExtTextOutW(g_hMeterDC, 0, 0, ETO_OPAQUE, &rh, nullptr, 0, nullptr);
+    }
+    SetBkColor(g_hMeterDC, prevBk);
+
+    BitBlt(hdc, slot.rc.left, slot.rc.top, w, h, g_hMeterDC, 0, 0, SRCCOPY);
+}
+
+static void DestroyMeterBuffer() {
+    if (g_hMeterDC) {
+        SelectObject(g_hMeterDC, g_hMeterBmpOld);
+        DeleteObject(g_hMeterBmp);
+        DeleteDC(g_hMeterDC);
+        g_hMeterDC = nullptr;
+        g_hMeterBmp = nullptr;
+        g_hMeterBmpOld = nullptr;
+        g_meterBufW = g_meterBufH = 0;
+    }
 }
 
 // ===== Refresh (enumerate + repopulate if changed) =====
 static void RefreshSessionsAndUI(BOOL keepSelection) {
-    bool changed = BuildSessionListAndRegisterAndGetChanged();
-    if (changed) {
+    bool ruleAssigned = false;
+    bool changed = BuildSessionListAndRegisterAndGetChanged(ruleAssigned);
+    if (changed || ruleAssigned) {
         RepopulateCombos(keepSelection);
     }
+    if (changed) {
+        ReleaseMeters(); // セッションが作り直された可能性があるので取り直す
+    }
+    if (ruleAssigned) {
+        ApplyBalanceFromTrackbar(); // ルールで選ばれたペアへ即反映
+    }
 }
 
 // ===== Init / Uninit WASAPI =====
-static bool InitWasapi() {
-    if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&g_pEnumerator))))
-        return false;
-    if (FAILED(g_pEnumerator->GetDefaultAudioEndpoint(eRender, DEVICE_ROLE, &g_pDevice)))
+// 既定の出力デバイスへ接続。デバイスが無い（全て取り外された）場合は false のまま待機し、
+// DeviceWatcher の通知で再試行する
+static bool BindDefaultDevice() {
+    if (!g_pEnumerator) return false;
+    if (FAILED(g_pEnumerator->GetDefaultAudioEndpoint(eRender, DEVICE_ROLE, &g_pDevice)) || !g_pDevice)
         return false;
-    if (FAILED(g_pDevice->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL, nullptr, (void**)&g_pSessionMgr2)))
+    if (FAILED(g_pDevice->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL, nullptr, (void**)&g_pSessionMgr2))) {
+        g_pDevice->Release(); g_pDevice = nullptr;
+        g_pSessionMgr2 = nullptr;
         return false;
+    }
+    LPWSTR id = nullptr;
+    if (SUCCEEDED(g_pDevice->GetId(&id)) && id) { g_deviceId = id; CoTaskMemFree(id); }
+
+    // 前回の異常終了や、以前このデバイスで残った記録があれば、触る前に元へ戻す
+    RestoreAllSessionVolumes();
 
     // Watcher 起動：先に Manager へ登録 → 初回列挙
     g_pWatcher = new SessionWatcher(g_hWnd, g_pSessionMgr2);
@@ -482,7 +1084,8 @@ static bool InitWasapi() {
     return true;
 }
 
-static void UninitWasapi() {
+static void UnbindDevice() {
+    ReleaseMeters();
     if (g_pSessionMgr2 && g_pWatcher) {
         g_pSessionMgr2->UnregisterSessionNotification(g_pWatcher);
         g_pWatcher->Release();
@@ -490,6 +1093,37 @@ static void UninitWasapi() {
     }
     if (g_pSessionMgr2) { g_pSessionMgr2->Release(); g_pSessionMgr2 = nullptr; }
     if (g_pDevice) { g_pDevice->Release();      g_pDevice = nullptr; }
+    g_deviceId.clear();
+
+    // セッション情報は旧デバイスのものなので破棄（再接続時に列挙し直す）
+    g_registeredSids.clear();
+    g_lastSids.clear();
+    g_ruleBySession.clear();
+    g_sessions.clear();
+    RepopulateCombos(TRUE);
+}
+
+static bool InitWasapi() {
+    if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&g_pEnumerator))))
+        return false;
+
+    // デバイス変更の監視（デバイスが無くても先に登録しておく）
+    g_pDeviceWatcher = new DeviceWatcher(g_hWnd);
+    if (g_pDeviceWatcher) {
+        g_pEnumerator->RegisterEndpointNotificationCallback(g_pDeviceWatcher);
+    }
+
+    BindDefaultDevice();
+    return true;
+}
+
+static void UninitWasapi() {
+    UnbindDevice();
+    if (g_pEnumerator && g_pDeviceWatcher) {
+        g_pEnumerator->UnregisterEndpointNotificationCallback(g_pDeviceWatcher);
+        g_pDeviceWatcher->Release();
+        g_pDeviceWatcher = nullptr;
+    }
     if (g_pEnumerator) { g_pEnumerator->Release();  g_pEnumerator = nullptr; }
 }
 
@@ -501,20 +1135,29 @@ static void DoLayout(HWND hWnd) {
     const int margin = 8;
     const int comboWidth = (w - (margin * 3)) / 2;
     const int comboHeight = 200;
+    const int meterHeight = 10;
     const int trackHeight = 40;
     const int radioHeight = 24;
 
     MoveWindow(g_comboA, margin, margin, comboWidth, comboHeight, TRUE);
     MoveWindow(g_comboB, margin * 2 + comboWidth, margin, comboWidth, comboHeight, TRUE);
 
-    int trackY = margin + comboHeight + margin;
+    // メーターは各コンボの直下
+    int meterY = margin + comboHeight + margin;
+    SetRect(&g_meterA.rc, margin, meterY, margin + comboWidth, meterY + meterHeight);
+    SetRect(&g_meterB.rc, margin * 2 + comboWidth, meterY, margin * 2 + comboWidth * 2, meterY + meterHeight);
+    g_meterA.meter.barPx = g_meterA.meter.holdPx = -1; // 幅が変わったので次フレームで必ず再描画
+    g_meterB.meter.barPx = g_meterB.meter.holdPx = -1;
+
+    int trackY = meterY + meterHeight + margin;
     MoveWindow(g_track, margin, trackY, w - margin * 2, trackHeight, TRUE);
 
-    // ラジオはトラックバーの下に左右配置
+    // ラジオと復元ボタンはトラックバーの下に横並び
     int radiosY = trackY + trackHeight + margin;
-    int halfW = (w - margin * 3) / 2;
-    MoveWindow(g_radioMax, margin, radiosY, halfW, radioHeight, TRUE);
-    MoveWindow(g_radioHalf, margin * 2 + halfW, radiosY, halfW, radioHeight, TRUE);
+    int colW = (w - margin * 4) / 3;
+    MoveWindow(g_radioMax, margin, radiosY, colW, radioHeight, TRUE);
+    MoveWindow(g_radioHalf, margin * 2 + colW, radiosY, colW, radioHeight, TRUE);
+    MoveWindow(g_btnRestore, margin * 3 + colW * 2, radiosY, colW, radioHeight, TRUE);
 }
 
 
@@ -559,8 +1202,24 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
         // 既定は CENTER MAX を選択
         SendMessage(g_radioMax, BM_SETCHECK, BST_CHECKED, 0);
 
+        // 復元ボタン（触ったセッションの音量を起動前の状態へ戻す）
+        g_btnRestore = CreateWindowExW(0, L"BUTTON", L"音量を元に戻す",
+            WS_CHILD | WS_VISIBLE | WS_TABSTOP | BS_PUSHBUTTON,
+            0, 0, 0, 0, hWnd, (HMENU)IDC_BTN_RESTORE, g_hInst, nullptr);
+        SendMessage(g_btnRestore, WM_SETFONT, (WPARAM)g_hFontCombo, TRUE);
+
         DoLayout(hWnd);
 
+        // ルールファイル読み込み（初回列挙より前に）
+        LoadAppRules();
+
+        // 音量ジャーナル（前回の残りは InitWasapi で復元される）
+        OpenVolumeJournal();
+
+        // 外部ツール向け状態公開
+        OpenSharedState();
+        PublishSharedState();
+
         if (!InitWasapi()) {
             MessageBoxW(hWnd, L"WASAPI 初期化に失敗しました。", L"Error", MB_ICONERROR);
             PostQuitMessage(1);
@@ -568,6 +1227,9 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
 
         // 1秒ポーリング（イベント取りこぼし対策）
         SetTimer(hWnd, 1, 1000, nullptr);
+
+        // メーター更新
+        SetTimer(hWnd, TIMER_METER, 1000 / METER_FPS, nullptr);
         return 0;
     }
 
@@ -581,9 +1243,25 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
     }
 
     case WM_SIZE:
+        // 最小化中はメーターを完全に止める
+        if (wParam == SIZE_MINIMIZED) {
+            KillTimer(hWnd, TIMER_METER);
+            return 0;
+        }
+        SetTimer(hWnd, TIMER_METER, 1000 / METER_FPS, nullptr);
         DoLayout(hWnd);
         return 0;
 
+    case WM_PAINT: {
+        PAINTSTRUCT ps;
+        HDC hdc = BeginPaint(hWnd, &ps);
+        RECT tmp;
+        if (IntersectRect(&tmp, &ps.rcPaint, &g_meterA.rc)) PaintMeter(hdc, g_meterA);
+        if (IntersectRect(&tmp, &ps.rcPaint, &g_meterB.rc)) PaintMeter(hdc, g_meterB);
+        EndPaint(hWnd, &ps);
+        return 0;
+    }
+
     case WM_COMMAND: {
         const WORD id = LOWORD(wParam);
         const WORD code = HIWORD(wParam);
@@ -637,6 +1315,10 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
                 ApplyBalanceFromTrackbar();
                 return 0;
             }
+            else if (id == IDC_BTN_RESTORE) {
+                RestoreAllSessionVolumes(); // 次にトラックバーを動かすと再び記録・適用
+                return 0;
+            }
         }
         return 0;
     }
@@ -652,14 +1334,41 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
         if (wParam == 1) {
             RefreshSessionsAndUI(TRUE); // 変更時だけUI更新（選択維持）
         }
+        else if (wParam == TIMER_METER) {
+            SampleMetersFrame(hWnd);
+        }
         return 0;
 
     case WMAPP_REFRESH:
         RefreshSessionsAndUI(TRUE);
         return 0;
 
+    case WMAPP_DEVICE_CHANGED:
+        // 接続中なら、デバイスが有効になっただけの通知は無視
+        if (wParam == DEVICE_CHANGE_ACTIVE && g_pSessionMgr2) return 0;
+
+        // 旧デバイスのセッションを戻してから新しい既定デバイスへ付け替え。
+        // 出力デバイスが無ければ未接続のまま（コンボは空）次の通知を待つ
+        RestoreAllSessionVolumes();
+        UnbindDevice();
+        BindDefaultDevice();
+        return 0;
+
+    case WM_ENDSESSION:
+        if (wParam) {
+            RestoreAllSessionVolumes();
+            CloseVolumeJournal();
+            CloseSharedState();
+        }
+        return 0;
+
     case WM_DESTROY:
         KillTimer(hWnd, 1);
+        KillTimer(hWnd, TIMER_METER);
+        DestroyMeterBuffer();
+        RestoreAllSessionVolumes();
+        CloseVolumeJournal();
+        CloseSharedState();
         UninitWasapi();
         PostQuitMessage(0);
         return 0;
@@ -716,7 +1425,7 @@ int APIENTRY wWinMain(
 
 
     g_hWnd = CreateWindowExW(0, CLASS_NAME, WINDOW_NAME,
-        WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 640, 360,
+        WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 640, 380,
         nullptr, nullptr, hInstance, nullptr);
     if (!g_hWnd) { CoUninitialize(); return 1; }
 
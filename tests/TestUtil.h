@@ -0,0 +1,14 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// ===== テスト用の最小ヘルパー =====
+#pragma once
+
+#include <cstdio>
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } \
+} while (0)
+
+#define TEST_RESULT() (g_failures == 0 ? (std::printf("OK\n"), 0) : (std::printf("%d failure(s)\n", g_failures), 1))
@@ -0,0 +1,56 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// AppRules.h のベンチマーク（ルール数を増やしても照合時間が伸びないことを確認する）。
+// 時間は環境に左右されるので ctest には含めず、数値を表示するだけ
+#include "AppRules.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// ruleCount 件のルールで sessions 件のセッションを照合した1件あたりの時間（ns、数回の最小値）
+static double MeasureMatchNs(int ruleCount, int sessions, int& hits) {
+    std::wstring text;
+    for (int i = 0; i < ruleCount / 2; ++i) {
+        text += L"exe:app" + std::to_wstring(i) + L".exe A\n";
+        text += L"name:*service" + std::to_wstring(i) + L"* ignore\n";
+    }
+    AppRuleSet set;
+    CompileAppRules(text, set);
+
+    std::vector<std::wstring> exes, names;
+    for (int i = 0; i < sessions; ++i) {
+        exes.push_back(L"App" + std::to_wstring(i * 7 % 20000) + L".exe");
+        names.push_back(L"Background Service" + std::to_wstring(i * 13 % 20000) + L" Host");
+    }
+
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) {
+        hits = 0;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < sessions; ++i) {
+            if (MatchAppRule(set, exes[i], names[i]) >= 0) ++hits;
+        }
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / sessions;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static void BenchScaling() {
+    const int sessions = 5000;
+    int hitsSmall = 0, hitsLarge = 0;
+    double small = MeasureMatchNs(10, sessions, hitsSmall);
+    double large = MeasureMatchNs(10000, sessions, hitsLarge);
+
+    std::printf("match: %5d rules %8.1f ns/session (%d hits)\n", 10, small, hitsSmall);
+    std::printf("match: %5d rules %8.1f ns/session (%d hits)\n", 10000, large, hitsLarge);
+    std::printf("ratio: %.2fx for 1000x rules\n", large / small);
+}
+
+int main() {
+    BenchScaling();
+    return 0;
+}
@@ -0,0 +1,108 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// AppRules.h のテスト
+#include "AppRules.h"
+#include "TestUtil.h"
+
+#include <chrono>
+#include <string>
+
+static void TestPatternForms() {
+    AppRuleSet set;
+    CompileAppRules(
+        L"# コメント\n"
+        L"exe:teams.exe       A\n"          // 0 完全一致
+        L"exe:chrome*         B gain=0.8\n" // 1 前方一致
+        L"exe:*player.exe     ignore\n"     // 2 後方一致
+        L"name:*Meeting*      B\n"          // 3 部分一致
+        L"name:\"Zoom Call\"  A gain=1.5\n" // 4 空白入り（gain は 1.0 に丸め）
+        , set);
+
+    CHECK(set.rules.size() == 5);
+    CHECK(MatchAppRule(set, L"Teams.EXE", L"x") == 0);
+    CHECK(MatchAppRule(set, L"ms-teams.exe", L"x") == -1);      // 完全一致は前に文字があると不一致
+    CHECK(MatchAppRule(set, L"teams.exe.bak", L"x") == -1);     // 後ろに文字があっても不一致
+    CHECK(MatchAppRule(set, L"chrome_proxy.exe", L"x") == 1);
+    CHECK(MatchAppRule(set, L"mychrome.exe", L"x") == -1);
+    CHECK(MatchAppRule(set, L"MediaPlayer.exe", L"x") == 2);
+    CHECK(MatchAppRule(set, L"player.exe.old", L"x") == -1);
+    CHECK(MatchAppRule(set, L"a.exe", L"Weekly meeting room") == 3);
+    CHECK(MatchAppRule(set, L"a.exe", L"zoom call") == 4);
+    CHECK(MatchAppRule(set, L"a.exe", L"zoom call 2") == -1);
+
+    CHECK(set.rules[1].side == RULE_SIDE_B && set.rules[1].gain > 0.79f && set.rules[1].gain < 0.81f);
+    CHECK(set.rules[2].ignore && set.rules[2].side == RULE_SIDE_NONE && set.rules[2].gain < 0.0f);
+    CHECK(set.rules[4].gain == 1.0f);
+}
+
+static void TestPriority() {
+    AppRuleSet set;
+    CompileAppRules(
+        L"name:*通知* ignore\n"  // 0
+        L"exe:teams.exe A\n"     // 1
+        L"exe:*.exe B\n"         // 2
+        L"exe:* gain=0.5\n"      // 3 すべてに一致
+        , set);
+
+    CHECK(MatchAppRule(set, L"teams.exe", L"Teams 通知") == 0);  // exe/name をまたいで上の行が優先
+    CHECK(MatchAppRule(set, L"teams.exe", L"Teams") == 1);       // 同じ文字列に複数一致しても上の行
+    CHECK(MatchAppRule(set, L"zoom.exe", L"Zoom") == 2);
+    CHECK(MatchAppRule(set, L"unknown", L"x") == 3);
+    CHECK(MatchAppRule(set, L"", L"") == 3);
+}
+
+static void TestInvalidLines() {
+    AppRuleSet set;
+    CompileAppRules(
+        L"exe:a*b A\n"             // 中間の '*'
+        L"exe:teams.exe\n"         // 動作なし
+        L"path:x.exe A\n"          // 不明なフィールド
+        L"exe:x.exe C\n"           // 不明な動作
+        L"exe:x.exe gain=abc\n"    // 数値でない
+        L"name:\"unterminated A\n" // 閉じ引用符なし
+        L"exe: A\n"                // 空パターン
+        L"   \r\n"
+        L"exe:ok.exe a # 行末コメント\r\n"
+        , set);
+
+    CHECK(set.rules.size() == 1);
+    CHECK(MatchAppRule(set, L"OK.exe", L"") == 0);
+    CHECK(set.rules[0].side == RULE_SIDE_A);
+
+    AppRuleSet empty;
+    CompileAppRules(L"", empty);
+    CHECK(MatchAppRule(empty, L"teams.exe", L"Teams") == -1);
+}
+
+// 1万件のルールでも一致結果が正しいこと（時間の計測は bench_app_rules で行う）
+static void TestLargeRuleSet() {
+    std::wstring text;
+    for (int i = 0; i < 5000; ++i) {
+        text += L"exe:app" + std::to_wstring(i) + L".exe A\n";
+        text += L"name:*service" + std::to_wstring(i) + L"* ignore\n";
+    }
+    AppRuleSet set;
+    CompileAppRules(text, set);
+    CHECK(set.rules.size() == 10000);
+
+    CHECK(MatchAppRule(set, L"App0.exe", L"x") == 0);
+    CHECK(MatchAppRule(set, L"app4999.exe", L"x") == 9998);
+    CHECK(MatchAppRule(set, L"app5000.exe", L"x") == -1);
+    CHECK(MatchAppRule(set, L"x.exe", L"Background Service4999 Host") == 9);  // *service4* が最も上
+    CHECK(MatchAppRule(set, L"app7.exe", L"service3") == 7);   // 上の行（name の 3番目）が優先
+    CHECK(MatchAppRule(set, L"app3.exe", L"service7") == 6);   // exe の 3番目が name の 7番目より上
+
+    int hits = 0;
+    for (int i = 0; i < 5000; ++i) {
+        if (MatchAppRule(set, L"App" + std::to_wstring(i * 7 % 20000) + L".exe", L"Host") >= 0) ++hits;
+    }
+    CHECK(hits == 1429);  // i*7%20000 < 5000 となる件数
+}
+
+int main() {
+    TestPatternForms();
+    TestPriority();
+    TestInvalidLines();
+    TestLargeRuleSet();
+    return TEST_RESULT();
+}
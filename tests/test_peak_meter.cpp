@@ -0,0 +1,111 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// PeakMeter.h のテスト（上昇・下降・ホールド・dB 範囲・再描画の間引き）
+#include "PeakMeter.h"
+#include "TestUtil.h"
+
+#include <cmath>
+
+static bool Near(float a, float b) { return std::fabs(a - b) < 1e-4f; }
+
+static void TestScale() {
+    CHECK(PeakToMeterScale(1.0f) == 1.0f);    // 0dB
+    CHECK(PeakToMeterScale(2.0f) == 1.0f);    // 0dB を超えても 1 で頭打ち
+    CHECK(PeakToMeterScale(0.001f) == 0.0f);  // -60dB
+    CHECK(PeakToMeterScale(0.0001f) == 0.0f); // -80dB は 0 に丸め
+    CHECK(PeakToMeterScale(0.0f) == 0.0f);
+    CHECK(PeakToMeterScale(-1.0f) == 0.0f);
+    CHECK(Near(PeakToMeterScale(0.031622777f), 0.5f)); // -30dB は中央
+}
+
+static void TestAttackAndDecay() {
+    PeakMeter m;
+    PeakMeterReset(m);
+
+    PeakMeterUpdate(m, 0.8f);
+    CHECK(m.level == 0.8f);  // 上昇は即時
+    CHECK(m.hold == 0.8f && m.holdLeft == METER_HOLD_FRAMES);
+
+    PeakMeterUpdate(m, 0.0f);
+    CHECK(Near(m.level, 0.8f - METER_DECAY_PER_FRAME));  // 下降は1フレームに一定量だけ
+
+    PeakMeterUpdate(m, 0.9f);
+    CHECK(m.level == 0.9f);
+
+    PeakMeterUpdate(m, 0.88f);
+    CHECK(Near(m.level, 0.88f));  // 下降量より小さい低下は入力に合わせる
+
+    PeakMeterUpdate(m, 5.0f);
+    CHECK(m.level == 1.0f && m.hold == 1.0f);  // 入力は 0..1 に制限
+}
+
+static void TestHoldExpiry() {
+    PeakMeter m;
+    PeakMeterReset(m);
+    PeakMeterUpdate(m, 1.0f);
+
+    for (int i = 0; i < METER_HOLD_FRAMES; ++i) {
+        PeakMeterUpdate(m, 0.0f);
+        CHECK(m.hold == 1.0f);  // ホールド期間中は保持
+    }
+    CHECK(m.holdLeft == 0);
+
+    PeakMeterUpdate(m, 0.0f);
+    CHECK(Near(m.hold, 1.0f - METER_DECAY_PER_FRAME));  // 期限切れ後に下降開始
+    CHECK(m.hold >= m.level);
+
+    // 無音が続けば最終的に両方 0
+    for (int i = 0; i < 200; ++i) PeakMeterUpdate(m, 0.0f);
+    CHECK(m.level == 0.0f && m.hold == 0.0f);
+}
+
+static void TestRepaintDecimation() {
+    PeakMeter m;
+    PeakMeterReset(m);
+
+    CHECK(!PeakMeterNeedsRepaint(m, 100));  // 0 のまま変化なし
+
+    PeakMeterUpdate(m, 0.5f);
+    CHECK(PeakMeterNeedsRepaint(m, 100));
+    CHECK(m.barPx == 50 && m.holdPx == 50);
+    CHECK(!PeakMeterNeedsRepaint(m, 100));  // 同じピクセルなら再描画しない
+
+    PeakMeterUpdate(m, 0.502f);             // 0.2px 未満の変化
+    CHECK(!PeakMeterNeedsRepaint(m, 100));
+
+    m.barPx = m.holdPx = -1;                // レイアウト変更・切り替え後は必ず再描画
+    CHECK(PeakMeterNeedsRepaint(m, 100));
+
+    CHECK(PeakMeterNeedsRepaint(m, 200));   // 幅が変わればピクセル値も変わる
+    CHECK(m.barPx == 100);
+
+    // 無音で下降しきった後は再描画要求が止まる
+    int repaints = 0;
+    for (int i = 0; i < 200; ++i) {
+        PeakMeterUpdate(m, 0.0f);
+        if (PeakMeterNeedsRepaint(m, 200)) ++repaints;
+    }
+    CHECK(repaints > 0 && repaints < 200);
+    CHECK(!PeakMeterNeedsRepaint(m, 200));
+
+    CHECK(!PeakMeterNeedsRepaint(m, -5));   // 負の幅は 0 扱い
+}
+
+static void TestReset() {
+    PeakMeter m;
+    PeakMeterReset(m);
+    PeakMeterUpdate(m, 1.0f);
+    PeakMeterNeedsRepaint(m, 100);
+    PeakMeterReset(m);
+    CHECK(m.level == 0.0f && m.hold == 0.0f && m.holdLeft == 0);
+    CHECK(m.barPx == 0 && m.holdPx == 0);
+}
+
+int main() {
+    TestScale();
+    TestAttackAndDecay();
+    TestHoldExpiry();
+    TestRepaintDecimation();
+    TestReset();
+    return TEST_RESULT();
+}
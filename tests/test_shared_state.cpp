@@ -0,0 +1,172 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// SharedState.h のテスト（POSIX 共有メモリ上で書き手1つ・読み手複数の seqlock を確認）
+#include "SharedState.h"
+#include "TestUtil.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string g_shmName;
+
+// 同じ共有メモリを別アドレスにマップ（プロセス間と同じ条件にする）
+static SharedStateBlock* MapBlock(bool create) {
+    int fd = shm_open(g_shmName.c_str(), create ? (O_CREAT | O_RDWR) : O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    if (create && ftruncate(fd, sizeof(SharedStateBlock)) != 0) { close(fd); return nullptr; }
+    void* p = mmap(nullptr, sizeof(SharedStateBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (p == MAP_FAILED) ? nullptr : (SharedStateBlock*)p;
+}
+
+static void UnmapBlock(SharedStateBlock* blk) {
+    munmap(blk, sizeof(SharedStateBlock));
+}
+
+// 1つのカウンタから全項目を作る（読んだ側で再計算して一致を確認）
+static SharedStatePayload MakePayload(uint32_t counter) {
+    SharedStatePayload p = {};
+    p.flags = SHARED_STATE_HAS_A | SHARED_STATE_HAS_B | SHARED_STATE_APPLIED;
+    p.mode = 1 + counter % 2;
+    p.position = (int32_t)(counter % 101);
+    p.a.pid = counter;
+    p.a.gain = (float)(counter % 1000) / 1000.0f;
+    p.b.pid = counter * 3u;
+    p.b.gain = 1.0f - p.a.gain;
+    for (int i = 0; i < SHARED_STATE_NAME_CHARS - 1; ++i) {
+        p.a.name[i] = (uint16_t)(L'a' + (counter + i) % 26);
+        p.b.name[i] = (uint16_t)(L'A' + (counter + i) % 26);
+    }
+    return p;
+}
+
+static bool IsConsistent(const SharedStatePayload& p) {
+    SharedStatePayload expect = MakePayload(p.a.pid);
+    return memcmp(&p, &expect, sizeof(p)) == 0;
+}
+
+static void TestConcurrentReaders() {
+    SharedStateBlock* w = MapBlock(true);
+    CHECK(w != nullptr);
+    if (!w) return;
+    SharedStateInit(w);
+
+    const uint32_t writes = 300000;
+    const int readerCount = 4;
+    std::atomic<bool> done(false);
+    std::atomic<long> reads(0), torn(0), backwards(0);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < readerCount; ++r) {
+        readers.push_back(std::thread([&]() {
+            SharedStateBlock* blk = MapBlock(false);
+            if (!blk) { torn++; return; }
+            uint32_t last = 0;
+            SharedStatePayload p;
+            while (!done.load()) {
+                if (!SharedStateRead(blk, p)) continue;
+                if (p.flags == 0) continue;  // 最初の書き込み前（ゼロ初期化のまま）
+                reads++;
+                if (!IsConsistent(p)) torn++;
+                if (p.a.pid < last) backwards++;
+                last = p.a.pid;
+            }
+            UnmapBlock(blk);
+        }));
+    }
+
+    for (uint32_t i = 1; i <= writes; ++i) SharedStateWrite(w, MakePayload(i));
+    done = true;
+    for (size_t r = 0; r < readers.size(); ++r) readers[r].join();
+
+    std::printf("shared state: %u writes, %ld consistent reads by %d readers\n", writes, reads.load(), readerCount);
+    CHECK(reads.load() > 0);
+    CHECK(torn.load() == 0);
+    CHECK(backwards.load() == 0);
+    CHECK(w->header.seq.load() == writes * 2);
+
+    SharedStatePayload last;
+    CHECK(SharedStateRead(w, last) && last.a.pid == writes);
+    UnmapBlock(w);
+}
+
+static void TestHeaderMismatch() {
+    SharedStateBlock* blk = MapBlock(false);
+    CHECK(blk != nullptr);
+    if (!blk) return;
+    SharedStatePayload p;
+    CHECK(SharedStateRead(blk, p));
+
+    blk->header.version = SHARED_STATE_VERSION + 1;
+    CHECK(!SharedStateRead(blk, p));
+    blk->header.version = SHARED_STATE_VERSION;
+
+    blk->header.size = (uint32_t)sizeof(SharedStateBlock) - 4;
+    CHECK(!SharedStateRead(blk, p));
+    blk->header.size = (uint32_t)sizeof(SharedStateBlock) + 64;  // 末尾に項目が増えた新しい書き手は読める
+    CHECK(SharedStateRead(blk, p));
+    blk->header.size = (uint32_t)sizeof(SharedStateBlock);
+
+    blk->header.magic = 0;
+    CHECK(!SharedStateRead(blk, p));
+    blk->header.magic = SHARED_STATE_MAGIC;
+
+    // 書き込み中（奇数）のままなら取れない
+    uint32_t seq = blk->header.seq.load();
+    blk->header.seq.store(seq + 1);
+    CHECK(!SharedStateRead(blk, p, 8));
+    blk->header.seq.store(seq);
+    UnmapBlock(blk);
+}
+
+// 読み手が開いたまま書き手が落ちて再起動した場合
+static void TestWriterRestart() {
+    SharedStateBlock* reader = MapBlock(false);
+    SharedStateBlock* oldWriter = MapBlock(false);
+    CHECK(reader && oldWriter);
+    if (!reader || !oldWriter) return;
+
+    uint32_t before = oldWriter->header.seq.load();
+    oldWriter->header.seq.store(before + 1);  // 書き込み途中で異常終了
+    UnmapBlock(oldWriter);
+
+    SharedStateBlock* newWriter = MapBlock(false);
+    SharedStateInit(newWriter);
+    CHECK(newWriter->header.seq.load() == before + 1);  // seq は巻き戻さない
+
+    SharedStatePayload p = MakePayload(7);
+    p.flags = 0;
+    SharedStateWrite(newWriter, p);
+    CHECK(newWriter->header.seq.load() == before + 2);
+
+    SharedStatePayload got;
+    CHECK(SharedStateRead(reader, got));
+    CHECK(got.a.pid == 7 && got.flags == 0);
+
+    // 初回（ゼロ初期化）は seq 0 から
+    SharedStateBlock fresh{};
+    SharedStateInit(&fresh);
+    CHECK(fresh.header.seq.load() == 0);
+    CHECK(!SharedStateRead(&fresh, got, 1) || got.a.pid == 0);
+
+    UnmapBlock(newWriter);
+    UnmapBlock(reader);
+}
+
+int main() {
+    g_shmName = "/tavb_state_test_" + std::to_string((long)getpid());
+    shm_unlink(g_shmName.c_str());
+
+    TestConcurrentReaders();
+    TestHeaderMismatch();
+    TestWriterRestart();
+
+    shm_unlink(g_shmName.c_str());
+    return TEST_RESULT();
+}
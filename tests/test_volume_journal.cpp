@@ -0,0 +1,271 @@
+﻿/* Please note: This code was created by AI, but has not been verified for copyright infringement. */
+
+// VolumeJournal.h のテスト（偽のセッション列で記録・復元・異常終了からの回復を確認）
+#include "VolumeJournal.h"
+#include "TestUtil.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FakeSession : SessionVolumeControl {
+    std::wstring sid;
+    uint32_t     pid;
+    float        volume;
+    bool         mute;
+    int          sets;  // SetVolume が呼ばれた回数
+
+    FakeSession(const std::wstring& s, uint32_t p, float v, bool m) : sid(s), pid(p), volume(v), mute(m), sets(0) {}
+
+    bool GetVolume(float& v, bool& m) override { v = volume; m = mute; return true; }
+    void SetVolume(float v, bool m) override { volume = v; mute = m; ++sets; }
+};
+
+struct FakeBackend : SessionVolumeBackend {
+    std::vector<FakeSession> sessions;
+    std::wstring device;         // このデバイスのセッションの SID 先頭
+    bool fail = false;           // 列挙失敗（デバイスが抜かれた等）
+    int enumerations = 0;
+
+    bool ForEachSession(const SessionVolumeVisitor& visit) override {
+        if (fail) return false;
+        ++enumerations;
+        for (size_t i = 0; i < sessions.size(); ++i) visit(sessions[i].sid, sessions[i].pid, sessions[i]);
+        return true;
+    }
+    bool Owns(const std::wstring& sid) const override { return sid.compare(0, device.size(), device) == 0; }
+};
+
+static FakeBackend MakeSessions(int n, uint32_t pidBase = 1000, const std::wstring& device = L"{0.0.0.00000000}.{guid}") {
+    FakeBackend b;
+    b.device = device;
+    for (int i = 0; i < n; ++i) {
+        std::wstring sid = device + L"|\\Device\\HarddiskVolume3\\Apps\\app" + std::to_wstring(i) +
+                           L".exe%b{00000000-0000-0000-0000-000000000000}";
+        b.sessions.push_back(FakeSession(sid, pidBase + i, (float)(i % 100) / 100.0f, (i % 7) == 0));
+    }
+    return b;
+}
+
+static bool NoneLive(const std::wstring&, uint32_t) { return false; }
+
+// バランス調整で全セッションの音量を変える（変更前に記録）
+static void TouchAll(VolumeJournal& j, FakeBackend& b) {
+    for (size_t i = 0; i < b.sessions.size(); ++i) {
+        FakeSession& s = b.sessions[i];
+        j.SnapshotIfFirst(s.sid, s.pid, s);
+        s.volume = 0.25f;
+        s.mute = false;
+        j.SnapshotIfFirst(s.sid, s.pid, s); // 2回目は記録しない
+        s.volume = 0.5f;
+    }
+}
+
+static void CheckOriginal(const FakeBackend& b, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(b.sessions[i].volume == (float)(i % 100) / 100.0f);
+        CHECK(b.sessions[i].mute == ((i % 7) == 0));
+    }
+}
+
+static void TestRestoreIsBatchedAndIdempotent() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    FakeBackend b = MakeSessions(300);
+    VolumeJournal j;
+    j.Attach(file.get(), nullptr);
+
+    TouchAll(j, b);
+    CHECK(j.snapshots.size() == 300);
+    CHECK(file->count == JOURNAL_MAX_ENTRIES);  // 257件目以降はメモリ上のみ
+
+    CHECK(j.RestoreAll(b) == 300);
+    CHECK(b.enumerations == 1);                 // 1回の列挙でまとめて戻す
+    CheckOriginal(b, 300);
+    CHECK(j.snapshots.empty());
+    CHECK(file->count == 0);
+
+    // 2回目は何もしない
+    CHECK(j.RestoreAll(b) == 0);
+    CHECK(b.enumerations == 1);
+    for (size_t i = 0; i < b.sessions.size(); ++i) CHECK(b.sessions[i].sets == 1);
+    CheckOriginal(b, 300);
+}
+
+static void TestCrashRecovery() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    FakeBackend b = MakeSessions(300);
+    {
+        VolumeJournal j;
+        j.Attach(file.get(), nullptr);
+        TouchAll(j, b);
+        // ここで異常終了（RestoreAll されない）
+    }
+
+    // 書きかけ（used==0）のスロットと、count 更新前に落ちたスロットを作る
+    file->entries[5].used = 0;
+    file->count = 100;
+
+    VolumeJournal j2;
+    j2.Attach(file.get(), nullptr);
+    CHECK(j2.snapshots.size() == JOURNAL_MAX_ENTRIES - 1);  // 257件目以降と壊れた1件は戻らない
+    CHECK(file->count == JOURNAL_MAX_ENTRIES);               // 生きているスロットの後ろへ追記
+
+    CHECK(j2.RestoreAll(b) == JOURNAL_MAX_ENTRIES - 1);
+    for (size_t i = 0; i < JOURNAL_MAX_ENTRIES; ++i) {
+        if (i == 5) CHECK(b.sessions[i].volume == 0.5f);
+        else        CHECK(b.sessions[i].volume == (float)(i % 100) / 100.0f);
+    }
+    for (size_t i = JOURNAL_MAX_ENTRIES; i < b.sessions.size(); ++i) CHECK(b.sessions[i].volume == 0.5f);
+
+    // 復元後のジャーナルは空
+    VolumeJournal j3;
+    j3.Attach(file.get(), nullptr);
+    CHECK(j3.snapshots.empty());
+    CHECK(file->count == 0);
+}
+
+static void TestEndedSessionsAndFormat() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    file->magic = 0x12345678;  // 未初期化・別形式のファイル
+    file->entries[0].used = 1;
+
+    VolumeJournal j;
+    j.Attach(file.get(), nullptr);
+    CHECK(j.snapshots.empty());
+    CHECK(file->magic == JOURNAL_MAGIC && file->version == JOURNAL_VERSION);
+    CHECK(file->entries[0].used == 0);
+
+    // 復元までに終了したセッションは無視して記録だけ消す
+    FakeBackend b = MakeSessions(3);
+    TouchAll(j, b);
+    b.sessions.erase(b.sessions.begin() + 1);
+    CHECK(j.RestoreAll(b) == 2);
+    CHECK(j.snapshots.empty());
+
+    // 長すぎる SID はメモリ上のみ
+    FakeSession longSid(std::wstring(JOURNAL_SID_CHARS, L'x'), 1, 0.3f, false);
+    CHECK(j.SnapshotIfFirst(longSid.sid, longSid.pid, longSid));
+    CHECK(file->count == 0);
+    CHECK(!j.SnapshotIfFirst(L"", 1, longSid));
+}
+
+// 列挙に失敗したら記録もジャーナルも残し、次の機会に戻す
+static void TestFailedEnumerationKeepsJournal() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    FakeBackend b = MakeSessions(10);
+    VolumeJournal j;
+    j.Attach(file.get(), nullptr);
+    TouchAll(j, b);
+
+    b.fail = true;
+    CHECK(j.RestoreAll(b) == -1);
+    CHECK(j.snapshots.size() == 10);
+    CHECK(file->count == 10);
+    for (int i = 0; i < 10; ++i) CHECK(file->entries[i].used == 1);
+    for (size_t i = 0; i < b.sessions.size(); ++i) CHECK(b.sessions[i].sets == 0);
+
+    // そのまま終了しても次回起動時に戻せる
+    VolumeJournal j2;
+    j2.Attach(file.get(), nullptr);
+    CHECK(j2.snapshots.size() == 10);
+
+    b.fail = false;
+    CHECK(j.RestoreAll(b) == 10);
+    CheckOriginal(b, 10);
+    CHECK(file->count == 0);
+}
+
+// 終了したセッションのスロットを空け、新しいセッションの記録に使う
+static void TestEndedSessionSlotsAreReused() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    VolumeJournal j;
+    j.Attach(file.get(), nullptr);
+
+    // 起動し直すたびに PID が変わるアプリを想定
+    for (uint32_t round = 0; round < 4; ++round) {
+        FakeBackend b = MakeSessions(JOURNAL_MAX_ENTRIES, 1000 + round * 1000);
+        TouchAll(j, b);
+        CHECK(j.snapshots.size() == JOURNAL_MAX_ENTRIES);
+        CHECK(file->count == JOURNAL_MAX_ENTRIES);
+
+        // 異常終了しても全件戻せる
+        VolumeJournal recovered;
+        recovered.Attach(file.get(), nullptr);
+        CHECK(recovered.snapshots.size() == JOURNAL_MAX_ENTRIES);
+
+        CHECK(j.DropEnded(b, NoneLive) == JOURNAL_MAX_ENTRIES);
+        CHECK(j.snapshots.empty());
+        CHECK(file->count == 0);
+    }
+
+    // 途中のスロットが空いたら、そこへ書く
+    FakeBackend b = MakeSessions(5);
+    TouchAll(j, b);
+    FakeSession ended = b.sessions[2];
+    CHECK(j.DropEnded(b, [&](const std::wstring& sid, uint32_t pid) { return !(sid == ended.sid && pid == ended.pid); }) == 1);
+    CHECK(file->entries[2].used == 0);
+    CHECK(file->count == 5);
+
+    FakeSession next(b.sessions[2].sid, 9999, 0.7f, true);
+    CHECK(j.SnapshotIfFirst(next.sid, next.pid, next));
+    CHECK(file->entries[2].used == 1 && file->entries[2].pid == 9999);
+    CHECK(file->count == 5);
+}
+
+// 他のデバイスのセッションの記録は、そのデバイスへ接続するまで残す
+static void TestOtherDeviceSessionsAreKept() {
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    FakeBackend speakers = MakeSessions(3, 1000, L"{0.0.0.00000000}.{speakers}");
+    FakeBackend headphones = MakeSessions(4, 1000, L"{0.0.0.00000000}.{headphones}");
+    VolumeJournal j;
+    j.Attach(file.get(), nullptr);
+    TouchAll(j, headphones);
+    TouchAll(j, speakers);
+
+    // ヘッドホンを抜いてスピーカーに切り替えた
+    CHECK(j.DropEnded(speakers, NoneLive) == 3);
+    CHECK(j.snapshots.size() == 4);
+    speakers.sessions.clear();
+    CHECK(j.RestoreAll(speakers) == 0);
+    CHECK(j.snapshots.size() == 4);
+    CHECK(file->count == 4);
+
+    // ヘッドホンを戻したら元に戻す
+    CHECK(j.RestoreAll(headphones) == 4);
+    CheckOriginal(headphones, 4);
+    CHECK(j.snapshots.empty());
+    CHECK(file->count == 0);
+}
+
+static int g_flushes = 0;
+static void CountFlush(const void*, size_t) { ++g_flushes; }
+
+static void TestMemoryOnlyAndFlush() {
+    FakeBackend b = MakeSessions(10);
+    VolumeJournal mem;
+    mem.Attach(nullptr, nullptr);  // ジャーナルを開けなかった場合
+    TouchAll(mem, b);
+    CHECK(mem.RestoreAll(b) == 10);
+    CheckOriginal(b, 10);
+
+    std::unique_ptr<JournalFile> file(new JournalFile());
+    VolumeJournal j;
+    j.Attach(file.get(), CountFlush);
+    int before = g_flushes;
+    TouchAll(j, b);
+    CHECK(g_flushes > before);      // 記録ごとに書き出す
+    before = g_flushes;
+    j.RestoreAll(b);
+    CHECK(g_flushes == before + 1); // 消去は1回
+}
+
+int main() {
+    TestRestoreIsBatchedAndIdempotent();
+    TestCrashRecovery();
+    TestEndedSessionsAndFormat();
+    TestFailedEnumerationKeepsJournal();
+    TestEndedSessionSlotsAreReused();
+    TestOtherDeviceSessionsAreKept();
+    TestMemoryOnlyAndFlush();
+    return TEST_RESULT();
+}